@@ -0,0 +1,402 @@
+#include "box_store.h"
+#include "trade_data.h"
+#include <LittleFS.h>
+#include <stddef.h>
+#include <string.h>
+
+// =============================================================================
+// Box Database Implementation
+// =============================================================================
+
+#define BOX_DIR          "/box"
+#define BOX_RECORDS_PATH "/box/records.bin"
+#define BOX_INDEX_PATH   "/box/index.bin"
+#define BOX_PAGES        (BOX_MAX_RECORDS / BOX_PAGE_SIZE)
+
+#define BOX_LIVE         0x01
+
+static_assert(BOX_MAX_RECORDS % BOX_PAGE_SIZE == 0, "BOX_MAX_RECORDS must be a multiple of BOX_PAGE_SIZE");
+
+// On-flash record, one per id
+struct BoxRecord {
+    uint8_t flags;                          // BOX_LIVE
+    uint8_t gen;                            // Generation
+    uint8_t speciesIndex;
+    uint8_t reserved;
+    uint8_t monData[GEN2_PARTY_STRUCT_SIZE];
+    uint8_t ot[NAME_LENGTH];
+    uint8_t nickname[NAME_LENGTH];
+    uint8_t padding[2];
+};
+
+// On-flash index entry, one per id, same order as the records
+struct BoxIndexEntry {
+    uint8_t flags;
+    uint8_t gen;
+    uint8_t species;
+    uint8_t level;
+    uint16_t otHash;
+    uint16_t otId;
+};
+
+static_assert(sizeof(BoxRecord) == 76, "BoxRecord layout changed");
+static_assert(sizeof(BoxIndexEntry) == 8, "BoxIndexEntry layout changed");
+
+// In-RAM per-page summary: enough to rule a page out without reading it
+struct BoxPageSummary {
+    uint8_t live;
+    uint8_t genMask;                        // 1 << Generation
+    uint8_t minLevel;
+    uint8_t maxLevel;
+    uint32_t otBloom;                       // 1 << (otHash & 31)
+    uint8_t species[32];                    // Bitmap over species index
+};
+
+struct BoxPageCache {
+    int page;                               // -1 = empty
+    uint32_t lastUse;
+    BoxIndexEntry entries[BOX_PAGE_SIZE];
+};
+
+static SemaphoreHandle_t boxMutex = nullptr;
+static File recordsFile;
+static File indexFile;
+static bool ready = false;
+
+static BoxPageSummary summaries[BOX_PAGES];
+static BoxPageCache cache[BOX_PAGE_CACHE];
+static uint32_t cacheTick = 0;
+static uint16_t recordCount = 0;            // Ids allocated so far (file length)
+static int liveCount = 0;
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static uint16_t otHash(const uint8_t* name) {
+    uint32_t h = 2166136261u;               // FNV-1a
+    for (int i = 0; i < NAME_LENGTH && name[i] != 0x50; i++) {
+        h = (h ^ name[i]) * 16777619u;
+    }
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+static bool otNameEqual(const uint8_t* a, const uint8_t* b) {
+    for (int i = 0; i < NAME_LENGTH; i++) {
+        if (a[i] != b[i]) return false;
+        if (a[i] == 0x50) return true;
+    }
+    return true;
+}
+
+static uint8_t monLevel(Generation gen, const uint8_t* monData) {
+    if (gen == GEN_1) return ((const Gen1PartyMon*)monData)->level;
+    return ((const Gen2PartyMon*)monData)->level;
+}
+
+static uint16_t monOtId(Generation gen, const uint8_t* monData) {
+    const uint8_t* id = (gen == GEN_1) ? ((const Gen1PartyMon*)monData)->trainerId
+                                       : ((const Gen2PartyMon*)monData)->trainerId;
+    return ((uint16_t)id[0] << 8) | id[1];  // Big-endian
+}
+
+static void makeIndexEntry(const BoxRecord* rec, BoxIndexEntry* out) {
+    Generation gen = (Generation)rec->gen;
+    out->flags = rec->flags;
+    out->gen = rec->gen;
+    out->species = rec->speciesIndex;
+    out->level = monLevel(gen, rec->monData);
+    out->otHash = otHash(rec->ot);
+    out->otId = monOtId(gen, rec->monData);
+}
+
+// Ids on this page that exist in the files
+static int pageCapacity(int page) {
+    int first = page * BOX_PAGE_SIZE;
+    if (first >= recordCount) return 0;
+    int n = recordCount - first;
+    return n < BOX_PAGE_SIZE ? n : BOX_PAGE_SIZE;
+}
+
+static BoxPageCache* loadPage(int page) {
+    BoxPageCache* victim = &cache[0];
+    for (int i = 0; i < BOX_PAGE_CACHE; i++) {
+        if (cache[i].page == page) {
+            cache[i].lastUse = ++cacheTick;
+            return &cache[i];
+        }
+        if (cache[i].lastUse < victim->lastUse) victim = &cache[i];
+    }
+
+    memset(victim->entries, 0, sizeof(victim->entries));
+    int n = pageCapacity(page);
+    if (n > 0) {
+        indexFile.seek(page * BOX_PAGE_SIZE * sizeof(BoxIndexEntry));
+        indexFile.read((uint8_t*)victim->entries, n * sizeof(BoxIndexEntry));
+    }
+    victim->page = page;
+    victim->lastUse = ++cacheTick;
+    return victim;
+}
+
+static void summarizePage(int page, const BoxPageCache* pc) {
+    BoxPageSummary* s = &summaries[page];
+    memset(s, 0, sizeof(BoxPageSummary));
+    s->minLevel = 0xFF;
+
+    for (int i = 0; i < BOX_PAGE_SIZE; i++) {
+        const BoxIndexEntry* e = &pc->entries[i];
+        if (!(e->flags & BOX_LIVE)) continue;
+        s->live++;
+        s->genMask |= 1 << e->gen;
+        if (e->level < s->minLevel) s->minLevel = e->level;
+        if (e->level > s->maxLevel) s->maxLevel = e->level;
+        s->otBloom |= 1u << (e->otHash & 31);
+        s->species[e->species >> 3] |= 1 << (e->species & 7);
+    }
+}
+
+static void writeIndexEntry(uint16_t id, const BoxIndexEntry* e) {
+    indexFile.seek(id * sizeof(BoxIndexEntry));
+    indexFile.write((const uint8_t*)e, sizeof(BoxIndexEntry));
+    indexFile.flush();
+
+    int page = id / BOX_PAGE_SIZE;
+    for (int i = 0; i < BOX_PAGE_CACHE; i++) {
+        if (cache[i].page == page) cache[i].entries[id % BOX_PAGE_SIZE] = *e;
+    }
+    summarizePage(page, loadPage(page));
+}
+
+// Index file missing or out of step with the records: regenerate it
+static void rebuildIndex() {
+    indexFile = LittleFS.open(BOX_INDEX_PATH, "w+");
+    BoxRecord rec;
+    BoxIndexEntry e;
+    for (uint16_t id = 0; id < recordCount; id++) {
+        recordsFile.seek(id * sizeof(BoxRecord));
+        if (recordsFile.read((uint8_t*)&rec, sizeof(rec)) != sizeof(rec)) {
+            memset(&rec, 0, sizeof(rec));
+        }
+        makeIndexEntry(&rec, &e);
+        indexFile.write((const uint8_t*)&e, sizeof(e));
+    }
+    indexFile.flush();
+    Serial.printf("[BOX] Rebuilt index for %d records\n", recordCount);
+}
+
+static int findFreeId() {
+    for (int page = 0; page < BOX_PAGES; page++) {
+        int cap = pageCapacity(page);
+        if (cap == 0) break;
+        if (summaries[page].live >= cap) continue;
+        BoxPageCache* pc = loadPage(page);
+        for (int i = 0; i < cap; i++) {
+            if (!(pc->entries[i].flags & BOX_LIVE)) return page * BOX_PAGE_SIZE + i;
+        }
+    }
+    return (recordCount < BOX_MAX_RECORDS) ? recordCount : -1;
+}
+
+static bool pageMayMatch(const BoxQuery* q, const BoxPageSummary* s) {
+    if (s->live == 0) return false;
+    if (q->gen != GEN_UNKNOWN && !(s->genMask & (1 << q->gen))) return false;
+    if (q->species >= 0 && !(s->species[q->species >> 3] & (1 << (q->species & 7)))) return false;
+    if (q->minLevel > s->maxLevel || q->maxLevel < s->minLevel) return false;
+    if (q->matchOtName && !(s->otBloom & (1u << (otHash(q->otName) & 31)))) return false;
+    return true;
+}
+
+static bool entryMatches(const BoxQuery* q, uint16_t id, const BoxIndexEntry* e) {
+    if (!(e->flags & BOX_LIVE)) return false;
+    if (q->gen != GEN_UNKNOWN && e->gen != q->gen) return false;
+    if (q->species >= 0 && e->species != q->species) return false;
+    if (e->level < q->minLevel || e->level > q->maxLevel) return false;
+    if (q->otId >= 0 && e->otId != q->otId) return false;
+    if (q->matchOtName) {
+        if (e->otHash != otHash(q->otName)) return false;
+        // Hash hit: confirm against the record's name
+        uint8_t ot[NAME_LENGTH];
+        recordsFile.seek(id * sizeof(BoxRecord) + offsetof(BoxRecord, ot));
+        if (recordsFile.read(ot, NAME_LENGTH) != NAME_LENGTH) return false;
+        if (!otNameEqual(ot, q->otName)) return false;
+    }
+    return true;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void box_init() {
+    boxMutex = xSemaphoreCreateMutex();
+
+    if (!LittleFS.exists(BOX_DIR)) LittleFS.mkdir(BOX_DIR);
+    if (!LittleFS.exists(BOX_RECORDS_PATH)) {
+        File f = LittleFS.open(BOX_RECORDS_PATH, "w");
+        f.close();
+    }
+
+    recordsFile = LittleFS.open(BOX_RECORDS_PATH, "r+");
+    if (!recordsFile) {
+        Serial.println("[BOX] Cannot open record file");
+        return;
+    }
+    size_t n = recordsFile.size() / sizeof(BoxRecord);
+    recordCount = (n > BOX_MAX_RECORDS) ? BOX_MAX_RECORDS : n;
+
+    if (LittleFS.exists(BOX_INDEX_PATH)) {
+        indexFile = LittleFS.open(BOX_INDEX_PATH, "r+");
+    }
+    if (!indexFile || indexFile.size() != recordCount * sizeof(BoxIndexEntry)) {
+        if (indexFile) indexFile.close();
+        rebuildIndex();
+    }
+
+    for (int i = 0; i < BOX_PAGE_CACHE; i++) {
+        cache[i].page = -1;
+        cache[i].lastUse = 0;
+    }
+
+    // One sequential pass over the index (not the records) for the summaries
+    liveCount = 0;
+    for (int page = 0; page < BOX_PAGES; page++) {
+        if (pageCapacity(page) == 0) {
+            memset(&summaries[page], 0, sizeof(BoxPageSummary));
+            continue;
+        }
+        summarizePage(page, loadPage(page));
+        liveCount += summaries[page].live;
+    }
+
+    ready = true;
+    Serial.printf("[BOX] %d Pokemon in %d records\n", liveCount, recordCount);
+}
+
+int box_add(Generation gen, const StoredPokemon* mon) {
+    if (!ready) return -1;
+    xSemaphoreTake(boxMutex, portMAX_DELAY);
+
+    int id = findFreeId();
+    if (id < 0) {
+        xSemaphoreGive(boxMutex);
+        return -1;
+    }
+
+    BoxRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.flags = BOX_LIVE;
+    rec.gen = (uint8_t)gen;
+    rec.speciesIndex = mon->speciesIndex;
+    memcpy(rec.monData, mon->monData, sizeof(rec.monData));
+    memcpy(rec.ot, mon->ot, NAME_LENGTH);
+    memcpy(rec.nickname, mon->nickname, NAME_LENGTH);
+
+    // Record first: a crash before the index write leaves the index short,
+    // which box_init() detects and repairs
+    recordsFile.seek(id * sizeof(BoxRecord));
+    recordsFile.write((const uint8_t*)&rec, sizeof(rec));
+    recordsFile.flush();
+    if (id >= recordCount) recordCount = id + 1;
+
+    BoxIndexEntry e;
+    makeIndexEntry(&rec, &e);
+    writeIndexEntry(id, &e);
+    liveCount++;
+
+    xSemaphoreGive(boxMutex);
+    return id;
+}
+
+bool box_get(uint16_t id, Generation* gen, StoredPokemon* out) {
+    if (!ready || id >= recordCount) return false;
+    xSemaphoreTake(boxMutex, portMAX_DELAY);
+
+    BoxRecord rec;
+    recordsFile.seek(id * sizeof(BoxRecord));
+    bool ok = recordsFile.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec) &&
+              (rec.flags & BOX_LIVE);
+    xSemaphoreGive(boxMutex);
+    if (!ok) return false;
+
+    memset(out, 0, sizeof(StoredPokemon));
+    memcpy(out->monData, rec.monData, sizeof(rec.monData));
+    memcpy(out->ot, rec.ot, NAME_LENGTH);
+    memcpy(out->nickname, rec.nickname, NAME_LENGTH);
+    out->speciesIndex = rec.speciesIndex;
+    out->occupied = true;
+    *gen = (Generation)rec.gen;
+    return true;
+}
+
+bool box_remove(uint16_t id) {
+    if (!ready || id >= recordCount) return false;
+    xSemaphoreTake(boxMutex, portMAX_DELAY);
+
+    BoxPageCache* pc = loadPage(id / BOX_PAGE_SIZE);
+    BoxIndexEntry e = pc->entries[id % BOX_PAGE_SIZE];
+    bool wasLive = e.flags & BOX_LIVE;
+    if (wasLive) {
+        // Index first: a crash after it leaves an orphaned record, never a
+        // live index entry pointing at a freed slot
+        e.flags = 0;
+        writeIndexEntry(id, &e);
+
+        uint8_t flags = 0;
+        recordsFile.seek(id * sizeof(BoxRecord) + offsetof(BoxRecord, flags));
+        recordsFile.write(&flags, 1);
+        recordsFile.flush();
+        liveCount--;
+    }
+
+    xSemaphoreGive(boxMutex);
+    return wasLive;
+}
+
+int box_count() {
+    return liveCount;
+}
+
+void box_queryInit(BoxQuery* q) {
+    memset(q, 0, sizeof(BoxQuery));
+    q->gen = GEN_UNKNOWN;
+    q->species = -1;
+    q->minLevel = 0;
+    q->maxLevel = 255;
+    q->otId = -1;
+}
+
+int box_search(const BoxQuery* q, int startId, BoxHit* out, int maxHits, int* nextId) {
+    *nextId = -1;
+    if (!ready || startId < 0) return 0;
+    xSemaphoreTake(boxMutex, portMAX_DELAY);
+
+    int n = 0;
+    for (int page = startId / BOX_PAGE_SIZE; page < BOX_PAGES; page++) {
+        int cap = pageCapacity(page);
+        if (cap == 0) break;
+        if (!pageMayMatch(q, &summaries[page])) continue;
+
+        BoxPageCache* pc = loadPage(page);
+        int first = (page == startId / BOX_PAGE_SIZE) ? startId % BOX_PAGE_SIZE : 0;
+        for (int i = first; i < cap; i++) {
+            uint16_t id = page * BOX_PAGE_SIZE + i;
+            const BoxIndexEntry* e = &pc->entries[i];
+            if (!entryMatches(q, id, e)) continue;
+            if (n == maxHits) {
+                *nextId = id;
+                xSemaphoreGive(boxMutex);
+                return n;
+            }
+            out[n].id = id;
+            out[n].gen = (Generation)e->gen;
+            out[n].species = e->species;
+            out[n].level = e->level;
+            out[n].otId = e->otId;
+            n++;
+        }
+    }
+
+    xSemaphoreGive(boxMutex);
+    return n;
+}
@@ -0,0 +1,54 @@
+#ifndef BOX_STORE_H
+#define BOX_STORE_H
+
+#include "config.h"
+#include "storage.h"
+
+// =============================================================================
+// Box Database
+// Fixed-size records on LittleFS, addressed by id (record position). A small
+// index file (species, level, OT) is read a page at a time; each page has an
+// in-RAM summary so searches skip pages that can't match without reading them.
+// =============================================================================
+
+struct BoxQuery {
+    Generation gen;         // GEN_UNKNOWN = any
+    int species;            // -1 = any
+    int minLevel;
+    int maxLevel;
+    int otId;               // -1 = any
+    bool matchOtName;
+    uint8_t otName[NAME_LENGTH];  // Game Boy text, 0x50 terminated
+};
+
+struct BoxHit {
+    uint16_t id;
+    Generation gen;
+    uint8_t species;
+    uint8_t level;
+    uint16_t otId;
+};
+
+// Open (or create) the box files and build page summaries; needs LittleFS mounted
+void box_init();
+
+// Store a Pokemon; returns its id, or -1 if the box is full
+int box_add(Generation gen, const StoredPokemon* mon);
+
+// Read a stored Pokemon back; false if the id is empty
+bool box_get(uint16_t id, Generation* gen, StoredPokemon* out);
+
+// Free an entry
+bool box_remove(uint16_t id);
+
+// Live entries
+int box_count();
+
+// Matches with id >= startId, in id order. Returns hits written; *nextId is
+// where to resume, or -1 when the box has been fully searched.
+int box_search(const BoxQuery* q, int startId, BoxHit* out, int maxHits, int* nextId);
+
+// Match-anything query
+void box_queryInit(BoxQuery* q);
+
+#endif // BOX_STORE_H
@@ -0,0 +1,248 @@
+#include "capture.h"
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Session Capture Implementation
+// =============================================================================
+
+#define CAPTURE_DIR "/capture"
+
+static SemaphoreHandle_t captureMutex = nullptr;
+static bool ready = false;
+static bool enabled = false;
+static bool recording = false;          // Between begin() and end()
+static bool headerPending = false;      // File not created yet
+static bool closePending = false;       // end() seen; close after the last flush
+static uint16_t nextId = 0;
+static uint16_t activeId = 0;
+static File activeFile;
+static CaptureHeader header;
+
+// Filled by the loop, emptied by capture_flush (also the loop)
+static uint8_t buf[CAPTURE_BUF_SIZE];
+static size_t bufLen = 0;
+static uint32_t lostRecords = 0;
+static uint32_t lastUs = 0;
+static uint8_t lastResp = 0x00;
+
+#define CAPTURE_MAX_RECORD 8            // 5-byte varint + 3 bytes
+
+static void putVarint(uint32_t v) {
+    while (v >= 0x80) {
+        buf[bufLen++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    buf[bufLen++] = v;
+}
+
+// Room for one more record (plus a pending LOST marker)? Counts it lost if not.
+static bool reserve() {
+    if (bufLen + 2 * CAPTURE_MAX_RECORD > sizeof(buf)) {
+        lostRecords++;
+        return false;
+    }
+    if (lostRecords) {
+        putVarint(lostRecords << 2 | CAPTURE_REC_LOST);
+        lostRecords = 0;
+    }
+    return true;
+}
+
+static uint32_t elapsedUs() {
+    uint32_t now = micros();
+    uint32_t dt = now - lastUs;
+    lastUs = now;
+    return dt > 0x3FFFFFFF ? 0x3FFFFFFF : dt;
+}
+
+static uint16_t parseId(const char* name) {
+    const char* base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if (base[0] != 'c') return 0xFFFF;
+    return (uint16_t)strtoul(base + 1, nullptr, 10);
+}
+
+// Drop the oldest captures so one more fits under CAPTURE_MAX_FILES
+static void pruneOldest() {
+    CaptureInfo list[CAPTURE_MAX_FILES + 1];
+    int n = capture_list(list, CAPTURE_MAX_FILES + 1);
+    char path[32];
+    for (int i = 0; i + CAPTURE_MAX_FILES <= n; i++) {
+        capture_path(list[i].id, path, sizeof(path));
+        LittleFS.remove(path);
+    }
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void capture_init() {
+    captureMutex = xSemaphoreCreateRecursiveMutex();
+    if (!LittleFS.exists(CAPTURE_DIR)) LittleFS.mkdir(CAPTURE_DIR);
+
+    CaptureInfo list[CAPTURE_MAX_FILES];
+    int n = capture_list(list, CAPTURE_MAX_FILES);
+    nextId = n ? list[n - 1].id + 1 : 0;
+    ready = true;
+}
+
+void capture_setEnabled(bool on) {
+#if LINK_BACKEND == LINK_BACKEND_REPLAY
+    on = false;                         // Don't record the recordings
+#endif
+    enabled = on;
+}
+
+bool capture_isEnabled() {
+    return enabled;
+}
+
+bool capture_isRecording() {
+    return recording;
+}
+
+void capture_begin(TradeMode mode, int offerSlot, bool autoConfirm) {
+    if (!ready || !enabled || recording || closePending) return;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "PTCP", 4);
+    header.format = CAPTURE_FORMAT;
+    header.backend = LINK_BACKEND;
+    header.tradeMode = mode;
+    header.offerSlot = offerSlot;
+    header.autoConfirm = autoConfirm;
+    header.uptimeMs = millis();
+    memcpy(header.party[0], storage_getParty(GEN_1), sizeof(header.party[0]));
+    memcpy(header.party[1], storage_getParty(GEN_2), sizeof(header.party[1]));
+
+    activeId = nextId++;
+    recording = true;
+    headerPending = true;
+    bufLen = 0;
+    lostRecords = 0;
+    lastUs = micros();
+    lastResp = 0x00;                    // What resetConnection() stages
+}
+
+void capture_end() {
+    if (!recording) return;
+    recording = false;
+    closePending = true;
+}
+
+void capture_byte(uint8_t recv, uint8_t sent, uint8_t resp) {
+    if (!recording || !reserve()) return;
+    uint32_t dt = elapsedUs();
+    if (sent == lastResp) {
+        putVarint(dt << 2 | CAPTURE_REC_BYTE);
+        buf[bufLen++] = recv;
+        buf[bufLen++] = resp;
+    } else {
+        putVarint(dt << 2 | CAPTURE_REC_BYTE_S);
+        buf[bufLen++] = recv;
+        buf[bufLen++] = resp;
+        buf[bufLen++] = sent;
+    }
+    lastResp = resp;
+}
+
+void capture_state(uint8_t connState, uint8_t tcState) {
+    if (!recording || !reserve()) return;
+    putVarint(elapsedUs() << 2 | CAPTURE_REC_STATE);
+    buf[bufLen++] = connState;
+    buf[bufLen++] = tcState;
+}
+
+bool capture_isDirty() {
+    return headerPending || bufLen > 0 || closePending;
+}
+
+void capture_flush() {
+    if (!capture_isDirty()) return;
+    xSemaphoreTakeRecursive(captureMutex, portMAX_DELAY);
+
+    char path[32];
+    if (headerPending) {
+        pruneOldest();
+        capture_path(activeId, path, sizeof(path));
+        activeFile = LittleFS.open(path, "w");
+        if (activeFile) activeFile.write((const uint8_t*)&header, sizeof(header));
+        headerPending = false;
+    }
+    if (activeFile && bufLen > 0) activeFile.write(buf, bufLen);
+    bufLen = 0;
+
+    if (closePending) {
+        // A drop at the very end still gets its marker
+        if (lostRecords) {
+            putVarint(lostRecords << 2 | CAPTURE_REC_LOST);
+            if (activeFile) activeFile.write(buf, bufLen);
+            bufLen = 0;
+            lostRecords = 0;
+        }
+        if (activeFile) activeFile.close();
+        closePending = false;
+    } else if (activeFile) {
+        activeFile.flush();
+    }
+
+    xSemaphoreGiveRecursive(captureMutex);
+}
+
+int capture_list(CaptureInfo* out, int max) {
+    if (!captureMutex) return 0;
+    xSemaphoreTakeRecursive(captureMutex, portMAX_DELAY);
+
+    // Ascending id; with more than max files the newest are kept
+    int n = 0;
+    File dir = LittleFS.open(CAPTURE_DIR);
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        if (entry.isDirectory()) continue;
+        uint16_t id = parseId(entry.name());
+        if (id == 0xFFFF) continue;
+        if (n == max) {
+            if (id < out[0].id) continue;
+            memmove(&out[0], &out[1], (max - 1) * sizeof(CaptureInfo));
+            n--;
+        }
+        int i = n++;
+        while (i > 0 && out[i - 1].id > id) {
+            out[i] = out[i - 1];
+            i--;
+        }
+        out[i].id = id;
+        out[i].size = entry.size();
+    }
+    dir.close();
+
+    xSemaphoreGiveRecursive(captureMutex);
+    return n;
+}
+
+void capture_path(uint16_t id, char* path, size_t len) {
+    snprintf(path, len, CAPTURE_DIR "/c%04u.bin", (unsigned)id);
+}
+
+bool capture_isWriting(uint16_t id) {
+    if (!captureMutex) return false;
+    xSemaphoreTakeRecursive(captureMutex, portMAX_DELAY);
+    bool busy = (recording || closePending || headerPending) && id == activeId;
+    xSemaphoreGiveRecursive(captureMutex);
+    return busy;
+}
+
+bool capture_remove(uint16_t id) {
+    if (!captureMutex) return false;
+    xSemaphoreTakeRecursive(captureMutex, portMAX_DELAY);
+
+    bool busy = capture_isWriting(id);
+    char path[32];
+    capture_path(id, path, sizeof(path));
+    bool ok = !busy && LittleFS.remove(path);
+
+    xSemaphoreGiveRecursive(captureMutex);
+    return ok;
+}
@@ -0,0 +1,87 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "config.h"
+#include "storage.h"
+
+// =============================================================================
+// Session Capture
+// Records whole link sessions to LittleFS (/capture/cNNNN.bin) for offline
+// analysis and replay. Exchanges are buffered in RAM by the loop and written
+// by capture_flush() between sessions, like the journal.
+//
+// File: CaptureHeader, then records, each starting with a varint whose low
+// two bits are the record type and whose upper bits are the microseconds
+// since the previous record (CAPTURE_REC_LOST: the number of records lost):
+//   CAPTURE_REC_BYTE   recv, resp        (we sent our previous resp)
+//   CAPTURE_REC_BYTE_S recv, resp, sent  (we sent something else)
+//   CAPTURE_REC_STATE  connState, tcState after handling the byte
+//   CAPTURE_REC_LOST   RAM buffer was full; records were dropped
+// =============================================================================
+
+#define CAPTURE_FORMAT 1
+
+enum CaptureRecordType {
+    CAPTURE_REC_BYTE,
+    CAPTURE_REC_BYTE_S,
+    CAPTURE_REC_STATE,
+    CAPTURE_REC_LOST
+};
+
+// Engine inputs that shape our responses, so a replay can restore them
+struct CaptureHeader {
+    char magic[4];                          // "PTCP"
+    uint8_t format;                         // CAPTURE_FORMAT
+    uint8_t backend;                        // LINK_BACKEND it was recorded on
+    uint8_t tradeMode;
+    uint8_t offerSlot;
+    uint8_t autoConfirm;
+    uint8_t reserved[3];
+    uint32_t uptimeMs;                      // When the session started
+    StoredPokemon party[2][PARTY_LENGTH];   // Gen 1, Gen 2 party sources
+};
+
+struct CaptureInfo {
+    uint16_t id;
+    uint32_t size;
+};
+
+// Find existing captures; needs LittleFS mounted
+void capture_init();
+
+// Arm/disarm recording of the next sessions (loop task)
+void capture_setEnabled(bool enabled);
+bool capture_isEnabled();
+
+// Session bracket (loop task). begin() is a no-op unless enabled.
+void capture_begin(TradeMode mode, int offerSlot, bool autoConfirm);
+void capture_end();
+bool capture_isRecording();
+
+// Hot path: append to the RAM buffer only
+void capture_byte(uint8_t recv, uint8_t sent, uint8_t resp);
+void capture_state(uint8_t connState, uint8_t tcState);
+
+// Write buffered records; call only between sessions
+void capture_flush();
+bool capture_isDirty();
+
+// Web side (any task)
+int capture_list(CaptureInfo* out, int max);
+void capture_path(uint16_t id, char* buf, size_t len);
+bool capture_remove(uint16_t id);   // Refuses the capture being recorded
+bool capture_isWriting(uint16_t id); // Still recording or not yet flushed
+
+// =============================================================================
+// Replay (LINK_BACKEND_REPLAY only, implemented in link_replay.cpp)
+// The backend plays every capture back as the Game Boy and compares our
+// responses with the recorded ones. These tell loop() what to run it with.
+// =============================================================================
+
+// Changes whenever the backend moves on to the next capture
+uint32_t replay_sessionId();
+
+// Header of the capture being replayed (party + settings)
+const CaptureHeader* replay_header();
+
+#endif // CAPTURE_H
@@ -11,6 +11,17 @@
 #define PIN_MISO  6   // Game Boy -> ESP32 (SO on GB side)
 #define PIN_SCLK  7   // Clock from Game Boy
 #define PIN_LED   8   // Built-in LED
+#define PIN_SPI_CS 10 // SPI backend only: internal frame select, leave unconnected
+
+// Link transport backend — override with -DLINK_BACKEND=... in platformio.ini
+#define LINK_BACKEND_GPIO     0   // SCLK edge interrupts (default)
+#define LINK_BACKEND_SPI      1   // Hardware SPI slave (GPSPI2)
+                                  // 2: was the host backend, removed
+#define LINK_BACKEND_SIM      3   // In-process virtual Game Boy (benchmark/soak)
+#define LINK_BACKEND_REPLAY   4   // Play back /capture sessions, diff our responses
+#ifndef LINK_BACKEND
+#define LINK_BACKEND          LINK_BACKEND_GPIO
+#endif
 
 // Fast GPIO macros using direct register access
 #define READ_GPIO(pin)        ((REG_READ(GPIO_IN_REG) >> (pin)) & 1)
@@ -21,8 +32,31 @@
 // Timing Constants
 // =============================================================================
 #define IDLE_TIMEOUT_MS       1000    // No clock activity = session over
-#define BYTE_DELAY_US         100     // Delay between bytes
-#define CLOCK_TIMEOUT_US      500000  // 500ms timeout waiting for a clock edge
+#define FLUSH_IDLE_MS         100     // Clock quiet this long = safe to flush debug output
+#define CLOCK_TIMEOUT_US      500000  // Partial byte older than this is discarded
+
+// Once the clock is measured FLUSH_IDLE_MS and CLOCK_TIMEOUT_US become
+// ceilings. IDLE_TIMEOUT_MS stays fixed until captures show a shorter one is safe.
+#define LINK_TIMING_MIN_GAPS  32      // Pauses measured before the estimate is trusted
+#define LINK_PARTIAL_BITS     4       // Partial byte stale after this many bit periods
+#define LINK_PARTIAL_MIN_US   50      // ... but never sooner (edge ISR latency)
+#define LINK_FLUSH_GAPS       2       // Debug flush after 2x the longest pause seen
+#define FRAMING_RUN           4       // Rotated pattern bytes in a row = bit slip
+#define LINK_WAIT_MS          10      // Max time loop() sleeps waiting for a byte
+#define LINK_RING_SIZE        64      // Completed bytes buffered between ISR and loop
+#define LOG_RING_SIZE         64      // Log entries buffered for the formatting task
+#define LOG_DRAIN_MS          20      // Debug task sleep when it has nothing to send
+#define TRACE_BATCH_PAIRS     256     // SPI trace exchanges per WebSocket frame
+#define TRACE_BATCHES         4       // Trace batches in flight between loop and debug task
+#define COMMAND_RING_SIZE     16      // Web commands buffered for the loop
+#define TRADE_HOLD_MS         30000   // Default manual confirmation deadline (0 = don't hold)
+#define TRADE_HOLD_MAX_MS     600000
+
+// Link master mode (we drive SCLK)
+#define LINK_MASTER_TIMER       0     // Hardware timer that makes the clock edges
+#define LINK_MASTER_GAP_US      120   // Pause after each byte for the slave to reload
+#define LINK_MASTER_MIN_HALF_US 20    // Shorter half bits: GPSPI2 shifts, one interrupt per byte
+#define LINK_MASTER_BENCH_BYTES 512   // Bytes clocked at each rate by the benchmark
 
 // =============================================================================
 // Link Cable Protocol Constants
@@ -106,18 +140,60 @@
 #define GBP_TILE_SIZE         16    // Bytes per 8x8 tile (2bpp)
 #define GBP_TILES_PER_ROW     20    // 160px / 8px per tile
 #define GBP_MAX_IMAGE_SIZE    8192  // Max tile data per image
+#define GBP_BUSY_INQUIRIES    3     // INQUIRY answers with BUSY set after PRINT
+
+// =============================================================================
+// Simulator (LINK_BACKEND_SIM only)
+// =============================================================================
+#ifndef SIM_TRADES_PER_SESSION
+#define SIM_TRADES_PER_SESSION   4     // Confirmed trades before the virtual GB disconnects
+#endif
+#ifndef SIM_SESSIONS
+#define SIM_SESSIONS             0     // Sessions to run, then stop (0 = soak forever)
+#endif
+#ifndef SIM_PRINT_EVERY
+#define SIM_PRINT_EVERY          0     // Every Nth session prints instead of trading (0 = never)
+#endif
+#ifndef SIM_FAULT_EVERY
+#define SIM_FAULT_EVERY          0     // Drop or add a clock edge about every N bytes (0 = never)
+#endif
+#define SIM_REPORT_EVERY         50    // Log a perf report every N sessions
+#define SIM_YIELD_BYTES          256   // Sleep one tick every N bytes (keeps the idle task fed)
+#define SIM_STALL_BYTES          4096  // Phase stuck this long = protocol error, disconnect
+#ifndef PATCH_SELFTEST
+#define PATCH_SELFTEST           (LINK_BACKEND == LINK_BACKEND_SIM)  // Check the patch codec at boot
+#endif
+#define PATCH_SELFTEST_ROUNDS    2000  // Random blocks per self-test
+#ifndef REPLAY_LOOP
+#define REPLAY_LOOP              0     // 1 = replay the captures forever (soak)
+#endif
 
 // =============================================================================
 // Storage Constants
 // =============================================================================
 #define MAX_STORED_POKEMON    6
 #define MAX_PRINTER_IMAGES    5     // FIFO depth for printed images
+#define BOX_MAX_RECORDS       1024  // LittleFS box database capacity
+#define BOX_PAGE_SIZE         32    // Index entries per lazily loaded page
+#define BOX_PAGE_CACHE        2     // Index pages held in RAM
+#define STORAGE_RETRY_MS      5000  // A failed NVS commit is retried after this
+#define JOURNAL_SEGMENTS      8     // Segment files kept; the oldest is dropped
+#define JOURNAL_SEGMENT_RECORDS 128 // Trade records per segment file
+#define JOURNAL_PENDING       8     // Records queued in RAM between flushes
+#define CAPTURE_BUF_SIZE      8192  // Session capture bytes buffered between flushes
+#define CAPTURE_MAX_FILES     16    // Captures kept; the oldest is dropped
+#define GALLERY_MAX_IMAGES    64    // Saved prints kept; the oldest is dropped
+#define GALLERY_MAX_BYTES     (512 * 1024)  // Flash budget for prints + thumbnails
+#define GALLERY_THUMB_TILES   10    // Thumbnail width in tiles (half scale)
 
 // =============================================================================
 // WiFi Configuration
 // =============================================================================
 #define WIFI_SSID             "PokeTool"
 #define WIFI_PASSWORD         "poketool"
+#define STATE_PUSH_MS         100     // Min gap between live state pushes (coalesces bursts)
+#define PNG_STREAMS           2       // Printed images encoded to PNG at the same time
+#define JSON_BODIES           2       // JSON responses served in place at the same time
 
 // =============================================================================
 // Application State
@@ -0,0 +1,70 @@
+#include "debug_log.h"
+#include "spsc_ring.h"
+#include "wifi_server.h"
+#include <stdio.h>
+
+// =============================================================================
+// Deferred Log Implementation
+// =============================================================================
+
+struct LogEntry {
+    const char* fmt;
+    uint32_t ms;
+    uint8_t argc;
+    uintptr_t args[LOG_MAX_ARGS];
+};
+
+static SpscRing<LogEntry, LOG_RING_SIZE> ring;
+static uint32_t written = 0;
+static volatile uint32_t dropped = 0;
+
+static void formatEntry(const LogEntry* e, char* buf, size_t len) {
+    // Unused trailing words are ignored by snprintf
+    const uintptr_t* a = e->args;
+    snprintf(buf, len, e->fmt, a[0], a[1], a[2], a[3], a[4], a[5],
+             a[6], a[7], a[8], a[9], a[10], a[11]);
+}
+
+// Also carries the SPI trace: finished batches are encoded and sent here
+static void logTask(void* arg) {
+    static char buf[256];
+    LogEntry e;
+    for (;;) {
+        bool busy = debug_spi_drain();
+        if (ring.pop(&e)) {
+            formatEntry(&e, buf, sizeof(buf));
+            Serial.print(buf);
+            wifi_sendLog(buf, e.ms);
+            busy = true;
+        }
+        if (!busy) vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    }
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void log_init() {
+    // Idle priority: formatting and Serial only run while loop() is blocked
+    xTaskCreate(logTask, "log", 3072, nullptr, tskIDLE_PRIORITY, nullptr);
+}
+
+bool log_push(const char* fmt, uint8_t argc, const uintptr_t* args) {
+    LogEntry e;
+    e.fmt = fmt;
+    e.ms = millis();
+    e.argc = argc;
+    for (uint8_t i = 0; i < LOG_MAX_ARGS; i++) e.args[i] = i < argc ? args[i] : 0;
+    if (!ring.push(e)) {
+        dropped++;
+        return false;
+    }
+    written++;
+    return true;
+}
+
+void log_getStats(uint32_t* outWritten, uint32_t* outDropped) {
+    *outWritten = written;
+    *outDropped = dropped;
+}
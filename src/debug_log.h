@@ -0,0 +1,73 @@
+#ifndef DEBUG_LOG_H
+#define DEBUG_LOG_H
+
+#include "config.h"
+#include <stdint.h>
+
+// =============================================================================
+// Deferred debug log
+// =============================================================================
+// The loop task only records the format pointer, a timestamp and the raw
+// arguments in a lock-free ring; a low-priority task formats each entry later
+// and sends it to Serial and the SSE "log" event. Because formatting happens
+// after the call returns:
+//   - %s arguments must outlive the entry (literals, static name tables)
+//   - arguments are stored as machine words, so no %f / %lld
+//   - only the loop task (setup() included) may log; the ring has one producer
+// Levels above LOG_LEVEL compile to nothing, arguments included.
+
+#define LOG_LEVEL_ERROR  0
+#define LOG_LEVEL_WARN   1
+#define LOG_LEVEL_INFO   2
+#define LOG_LEVEL_DEBUG  3    // Per-state protocol transitions
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL        LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS     12
+
+#define LOG_AT(level, fmt, ...) do { \
+        if ((level) <= LOG_LEVEL) { \
+            log_checkFormat(fmt, ##__VA_ARGS__); \
+            log_capture(fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(fmt, ...)  LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)   LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)   LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...)  LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+// Start the formatting task. Call first thing in setup().
+void log_init();
+
+// Queue one entry; returns false (and counts a drop) if the ring is full
+bool log_push(const char* fmt, uint8_t argc, const uintptr_t* args);
+
+// Entries queued / dropped because the consumer fell behind (since boot)
+void log_getStats(uint32_t* written, uint32_t* dropped);
+
+// Empty; lets the compiler check each call site's format string
+inline void log_checkFormat(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+inline void log_checkFormat(const char* fmt, ...) {}
+
+template <typename T>
+inline uintptr_t log_arg(T v) {
+    return (uintptr_t)v;
+}
+uintptr_t log_arg(float v) = delete;     // Floating point can't be deferred
+uintptr_t log_arg(double v) = delete;
+
+inline void log_capture(const char* fmt) {
+    log_push(fmt, 0, nullptr);
+}
+
+template <typename... A>
+inline void log_capture(const char* fmt, A... a) {
+    static_assert(sizeof...(A) <= LOG_MAX_ARGS, "too many log arguments");
+    const uintptr_t args[] = { log_arg(a)... };
+    log_push(fmt, sizeof...(A), args);
+}
+
+#endif // DEBUG_LOG_H
@@ -0,0 +1,65 @@
+#include "framing.h"
+#include <string.h>
+
+// =============================================================================
+// Framing Monitor Implementation
+// =============================================================================
+
+// slipOf[expect][byte] = rotation (1-7) that turns a pattern into this byte
+static uint8_t slipOf[FRAMING_EXPECTS][256];
+
+static uint8_t runByte = 0;
+static uint8_t runLen = 0;
+
+static FramingStats stats;
+
+static uint8_t rotl(uint8_t b, int s) {
+    return (uint8_t)((b << s) | (b >> (8 - s)));
+}
+
+static void addPattern(FramingExpect expect, uint8_t pattern) {
+    for (int s = 1; s < 8; s++) {
+        uint8_t r = rotl(pattern, s);
+        if (r != pattern) slipOf[expect][r] = s;
+    }
+}
+
+void framing_init() {
+    memset(slipOf, 0, sizeof(slipOf));
+    addPattern(FRAMING_HANDSHAKE, PKMN_MASTER);
+    addPattern(FRAMING_HANDSHAKE, PKMN_CONNECTED);
+    addPattern(FRAMING_HANDSHAKE, PKMN_CONNECTED_GEN2);
+    addPattern(FRAMING_PREAMBLE, SERIAL_PREAMBLE_BYTE);
+}
+
+void framing_reset() {
+    runLen = 0;
+}
+
+int framing_check(uint8_t in, FramingExpect expect) {
+    int s = slipOf[expect][in];
+    if (s == 0) {
+        runLen = 0;
+        return 0;
+    }
+    if (runLen > 0 && in == runByte) {
+        runLen++;
+    } else {
+        runByte = in;
+        runLen = 1;
+    }
+    if (runLen < FRAMING_RUN) return 0;
+
+    runLen = 0;
+    stats.slips++;
+    stats.slipBits[s]++;
+    return s;
+}
+
+void framing_realigned() {
+    stats.realigned++;
+}
+
+void framing_getStats(FramingStats* out) {
+    *out = stats;
+}
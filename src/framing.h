@@ -0,0 +1,64 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include "config.h"
+
+// =============================================================================
+// Framing Monitor — catches bit slips from known byte runs
+// =============================================================================
+// A missed or spurious clock edge moves our byte boundary by a bit, and every
+// byte after it arrives shifted: a run of one value X shows up as a run of X
+// rotated left by the slip. The protocol has such runs where we know what to
+// expect (01 / 60 / 61 during the handshake, the FD preambles around each
+// trade block), so a run of a rotated pattern tells us both that we slipped
+// and by how much. loop() then moves the transport's bit counter to match,
+// and skips the check until bytes with the new boundary arrive.
+//
+// Patch-list terminators (FF) and the zero padding look the same at every
+// rotation, so they can't reveal a slip.
+
+enum FramingExpect {
+    FRAMING_NONE,                       // Payload: no pattern to check against
+    FRAMING_HANDSHAKE,                  // 01 master bytes, 60/61 connection bytes
+    FRAMING_PREAMBLE,                   // FD runs between trade blocks
+    FRAMING_EXPECTS
+};
+
+struct FramingStats {
+    uint32_t slips;                     // Rotated runs detected
+    uint32_t realigned;                 // ... and corrected in the transport
+    uint32_t slipBits[8];               // Slips by size (index 1-7)
+};
+
+void framing_init();
+void framing_reset();
+
+// Feed each received byte (loop task). Returns the slip in bits (1-7) when
+// FRAMING_RUN bytes in a row were one pattern rotated, else 0.
+int framing_check(uint8_t in, FramingExpect expect);
+
+// The transport took the correction returned by framing_check()
+void framing_realigned();
+
+void framing_getStats(FramingStats* out);
+
+// =============================================================================
+// Fault injection (LINK_BACKEND_SIM only, implemented in link_sim.cpp)
+// With SIM_FAULT_EVERY set, the virtual Game Boy drops or adds a clock edge
+// every so often and times how long we take to get back in step.
+// =============================================================================
+
+struct SimFaultStats {
+    uint32_t dropped;                   // Edges we "missed"
+    uint32_t glitches;                  // Spurious edges we "saw"
+    uint32_t byRealign;                 // Back in step through link_realign()
+    uint32_t byIdle;                    // ... through the idle gap at session end
+    uint32_t recoveryAvgBytes;          // Slipped bytes before back in step
+    uint32_t recoveryMaxBytes;
+    uint32_t recoveryAvgUs;
+    uint32_t recoveryMaxUs;
+};
+
+void sim_getFaultStats(SimFaultStats* out);
+
+#endif // FRAMING_H
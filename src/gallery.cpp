@@ -0,0 +1,373 @@
+#include "gallery.h"
+#include "printer.h"
+#include "png_stream.h"
+#include "journal.h"
+#include "debug_log.h"
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Printer Gallery Implementation
+// =============================================================================
+
+#define GALLERY_DIR      "/gallery"
+#define GALLERY_SEQ_PATH "/gallery/seq"     // nextId, volume tag
+#define GALLERY_ROW_BYTES (GBP_TILES_PER_ROW * GBP_TILE_SIZE)
+#define THUMB_ROW_BYTES   (GALLERY_THUMB_TILES * GBP_TILE_SIZE)
+
+static SemaphoreHandle_t galleryMutex = nullptr;
+static bool ready = false;
+
+static GalleryEntry entries[GALLERY_MAX_IMAGES];    // Oldest first
+static int entryCount = 0;
+static uint32_t usedBytes = 0;
+static uint32_t nextId = 1;
+static uint32_t volumeTag = 0;
+static uint32_t version = 0;
+static uint32_t savedPrinterId = 0;     // Newest printer FIFO id already saved
+
+// Thumbnail of the print being saved (loop task)
+static uint8_t thumb[(GBP_MAX_IMAGE_SIZE / GALLERY_ROW_BYTES + 1) / 2 * THUMB_ROW_BYTES];
+static PngStream thumbPng;
+
+static void printPath(char* buf, size_t len, uint32_t id) {
+    snprintf(buf, len, GALLERY_DIR "/p%08x.bin", (unsigned)id);
+}
+
+static uint32_t fileSize(const char* path) {
+    File f = LittleFS.open(path, "r");
+    if (!f) return 0;
+    uint32_t size = f.size();
+    f.close();
+    return size;
+}
+
+static void insertEntry(const GalleryEntry* e) {
+    int i = entryCount++;
+    while (i > 0 && entries[i - 1].id > e->id) {
+        entries[i] = entries[i - 1];
+        i--;
+    }
+    entries[i] = *e;
+    usedBytes += e->bytes;
+}
+
+static void removeFiles(uint32_t id) {
+    char path[32];
+    printPath(path, sizeof(path), id);
+    LittleFS.remove(path);
+    gallery_thumbPath(id, path, sizeof(path));
+    LittleFS.remove(path);
+}
+
+static void writeSeq() {
+    File f = LittleFS.open(GALLERY_SEQ_PATH, "w");
+    if (f) {
+        f.write((const uint8_t*)&nextId, sizeof(nextId));
+        f.write((const uint8_t*)&volumeTag, sizeof(volumeTag));
+        f.close();
+    }
+}
+
+static bool isListed(uint32_t id) {
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i].id == id) return true;
+    }
+    return false;
+}
+
+// Drop from the index only; the files stay until sweepUnlisted()
+static void dropAt(int i) {
+    usedBytes -= entries[i].bytes;
+    memmove(&entries[i], &entries[i + 1], (entryCount - i - 1) * sizeof(GalleryEntry));
+    entryCount--;
+    version++;
+}
+
+static void removeAt(int i) {
+    removeFiles(entries[i].id);
+    dropAt(i);
+}
+
+// Remove print files the index doesn't hold (evicted at init, torn writes).
+// Names are collected with the directory open and removed after it closes,
+// a batch at a time.
+static void sweepUnlisted() {
+    uint32_t ids[16];
+    int n;
+    do {
+        n = 0;
+        File dir = LittleFS.open(GALLERY_DIR);
+        for (File file = dir.openNextFile(); file && n < 16; file = dir.openNextFile()) {
+            const char* name = strrchr(file.name(), '/');
+            name = name ? name + 1 : file.name();
+            if (name[0] != 'p') continue;
+            uint32_t id = strtoul(name + 1, nullptr, 16);
+            if (!isListed(id)) ids[n++] = id;
+        }
+        dir.close();
+        for (int i = 0; i < n; i++) removeFiles(ids[i]);
+    } while (n == 16);
+}
+
+// =============================================================================
+// Thumbnails — half scale, each pixel the rounded mean of a 2x2 block
+// =============================================================================
+
+static int pixelAt(const uint8_t* data, int rows, int x, int y) {
+    if (y >= rows * 8) return 0;
+    const uint8_t* t = data + ((y / 8) * GBP_TILES_PER_ROW + x / 8) * GBP_TILE_SIZE + (y % 8) * 2;
+    int bit = 7 - (x % 8);
+    return ((t[1] >> bit) & 1) << 1 | ((t[0] >> bit) & 1);
+}
+
+static int buildThumb(const uint8_t* data, int rows) {
+    int thumbRows = (rows + 1) / 2;
+    memset(thumb, 0, thumbRows * THUMB_ROW_BYTES);
+    for (int y = 0; y < thumbRows * 8; y++) {
+        for (int x = 0; x < GALLERY_THUMB_TILES * 8; x++) {
+            int sum = pixelAt(data, rows, 2 * x, 2 * y) + pixelAt(data, rows, 2 * x + 1, 2 * y) +
+                      pixelAt(data, rows, 2 * x, 2 * y + 1) + pixelAt(data, rows, 2 * x + 1, 2 * y + 1);
+            int c = (sum + 2) / 4;
+            uint8_t* t = thumb + ((y / 8) * GALLERY_THUMB_TILES + x / 8) * GBP_TILE_SIZE + (y % 8) * 2;
+            uint8_t mask = 0x80 >> (x % 8);
+            if (c & 1) t[0] |= mask;
+            if (c & 2) t[1] |= mask;
+        }
+    }
+    return thumbRows;
+}
+
+static bool readThumbRow(void* ctx, int row, uint8_t* tiles) {
+    memcpy(tiles, thumb + row * THUMB_ROW_BYTES, THUMB_ROW_BYTES);
+    return true;
+}
+
+static uint32_t writeThumb(uint32_t id, int rows, uint8_t palette) {
+    char path[32];
+    gallery_thumbPath(id, path, sizeof(path));
+    File f = LittleFS.open(path, "w");
+    if (!f) return 0;
+
+    png_begin(&thumbPng, GALLERY_THUMB_TILES, rows, palette, PNG_FIXED, readThumbRow, nullptr);
+    uint8_t buf[256];
+    uint32_t total = 0;
+    size_t n;
+    while ((n = png_read(&thumbPng, buf, sizeof(buf))) > 0) {
+        f.write(buf, n);
+        total += n;
+    }
+    f.close();
+    return total;
+}
+
+// =============================================================================
+// Saving
+// =============================================================================
+
+static bool savePrint(const PrinterImage* img) {
+    uint16_t rows = img->length / GALLERY_ROW_BYTES;
+
+    GalleryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "PTGB", 4);
+    h.format = GALLERY_FORMAT;
+    h.palette = img->palette;
+    h.margins = img->margins;
+    h.exposure = img->exposure;
+    h.rows = rows;
+    h.boot = journal_bootNumber();
+    h.id = nextId;
+    h.uptimeS = img->printedMs / 1000;
+
+    char path[32];
+    printPath(path, sizeof(path), h.id);
+    File f = LittleFS.open(path, "w");
+    if (!f) return false;
+    bool ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) &&
+              f.write(img->data, rows * GALLERY_ROW_BYTES) == rows * GALLERY_ROW_BYTES;
+    f.close();
+    if (!ok) {
+        LittleFS.remove(path);
+        return false;
+    }
+
+    uint32_t thumbBytes = writeThumb(h.id, buildThumb(img->data, rows), h.palette);
+
+    nextId++;
+    writeSeq();
+
+    GalleryEntry e;
+    e.id = h.id;
+    e.uptimeS = h.uptimeS;
+    e.bytes = sizeof(h) + rows * GALLERY_ROW_BYTES + thumbBytes;
+    e.rows = rows;
+    e.boot = h.boot;
+    e.palette = h.palette;
+    e.margins = h.margins;
+
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    // Count limit first, then the byte budget; the new print always stays
+    while (entryCount > 0 &&
+           (entryCount >= GALLERY_MAX_IMAGES || usedBytes + e.bytes > GALLERY_MAX_BYTES)) {
+        removeAt(0);
+    }
+    insertEntry(&e);
+    version++;
+    xSemaphoreGive(galleryMutex);
+
+    LOG_INFO("[GALLERY] Saved print %u: %u rows, %u bytes (%d kept, %u bytes)\n",
+             (unsigned)e.id, (unsigned)rows, (unsigned)e.bytes, entryCount, (unsigned)usedBytes);
+    return true;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void gallery_init() {
+    galleryMutex = xSemaphoreCreateMutex();
+    if (!LittleFS.exists(GALLERY_DIR)) LittleFS.mkdir(GALLERY_DIR);
+
+    File f = LittleFS.open(GALLERY_SEQ_PATH, "r");
+    if (f) {
+        f.read((uint8_t*)&nextId, sizeof(nextId));
+        f.read((uint8_t*)&volumeTag, sizeof(volumeTag));
+        f.close();
+    }
+    if (volumeTag == 0) {
+        // New (or wiped) gallery, or one from before the tag: ids may repeat
+        // ones a browser has cached
+        volumeTag = esp_random() | 1;
+        writeSeq();
+    }
+
+    bool stale = false;
+    File dir = LittleFS.open(GALLERY_DIR);
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        const char* name = strrchr(file.name(), '/');
+        name = name ? name + 1 : file.name();
+        if (name[0] != 'p') continue;
+
+        GalleryHeader h;
+        if (file.read((uint8_t*)&h, sizeof(h)) != sizeof(h) || memcmp(h.magic, "PTGB", 4) != 0 ||
+            h.format != GALLERY_FORMAT || file.size() != sizeof(h) + h.rows * GALLERY_ROW_BYTES) {
+            stale = true;                   // Torn write: swept below
+            continue;
+        }
+        if (entryCount == GALLERY_MAX_IMAGES) {
+            stale = true;
+            if (h.id < entries[0].id) continue;
+            dropAt(0);
+        }
+
+        char thumbPath[32];
+        gallery_thumbPath(h.id, thumbPath, sizeof(thumbPath));
+        GalleryEntry e;
+        e.id = h.id;
+        e.uptimeS = h.uptimeS;
+        e.bytes = file.size() + fileSize(thumbPath);
+        e.rows = h.rows;
+        e.boot = h.boot;
+        e.palette = h.palette;
+        e.margins = h.margins;
+        insertEntry(&e);
+        if (h.id >= nextId) nextId = h.id + 1;
+    }
+    dir.close();
+    if (stale) sweepUnlisted();
+
+    ready = true;
+    LOG_INFO("[GALLERY] %d prints, %u bytes, next id %u\n",
+             entryCount, (unsigned)usedBytes, (unsigned)nextId);
+}
+
+bool gallery_isDirty() {
+#if LINK_BACKEND == LINK_BACKEND_SIM || LINK_BACKEND == LINK_BACKEND_REPLAY
+    return false;                           // Benchmark prints stay in RAM
+#else
+    int n = printer_imageCount();
+    return ready && n > 0 && printer_image(n - 1)->id > savedPrinterId;
+#endif
+}
+
+int gallery_flush() {
+    if (!gallery_isDirty()) return 0;
+
+    int saved = 0;
+    for (int i = 0; i < printer_imageCount(); i++) {
+        const PrinterImage* img = printer_image(i);
+        if (img->id <= savedPrinterId) continue;
+        if (savePrint(img)) saved++;
+        savedPrinterId = img->id;           // A failed write isn't retried forever
+    }
+    return saved;
+}
+
+uint32_t gallery_getVersion() {
+    return version;
+}
+
+uint32_t gallery_volumeTag() {
+    return volumeTag;
+}
+
+int gallery_list(int offset, GalleryEntry* out, int max, int* total, uint32_t* used) {
+    if (!galleryMutex) return 0;
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    int n = 0;
+    for (int i = entryCount - 1 - offset; i >= 0 && n < max; i--) {
+        out[n++] = entries[i];
+    }
+    *total = entryCount;
+    *used = usedBytes;
+    xSemaphoreGive(galleryMutex);
+    return n;
+}
+
+bool gallery_get(uint32_t id, GalleryEntry* out) {
+    if (!galleryMutex) return false;
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    bool found = false;
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i].id == id) {
+            *out = entries[i];
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(galleryMutex);
+    return found;
+}
+
+bool gallery_remove(uint32_t id) {
+    if (!galleryMutex) return false;
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    bool found = false;
+    for (int i = 0; i < entryCount; i++) {
+        if (entries[i].id == id) {
+            removeAt(i);
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(galleryMutex);
+    return found;
+}
+
+void gallery_thumbPath(uint32_t id, char* buf, size_t len) {
+    snprintf(buf, len, GALLERY_DIR "/t%08x.png", (unsigned)id);
+}
+
+bool gallery_open(uint32_t id, File* file) {
+    char path[32];
+    printPath(path, sizeof(path), id);
+    *file = LittleFS.open(path, "r");
+    return (bool)*file;
+}
+
+bool gallery_readRow(File* file, int row, uint8_t* tiles) {
+    if (!file->seek(sizeof(GalleryHeader) + row * GALLERY_ROW_BYTES)) return false;
+    return file->read(tiles, GALLERY_ROW_BYTES) == GALLERY_ROW_BYTES;
+}
@@ -0,0 +1,71 @@
+#ifndef GALLERY_H
+#define GALLERY_H
+
+#include "config.h"
+#include <FS.h>
+
+// =============================================================================
+// Printer Gallery
+// Prints from the printer FIFO saved to LittleFS in their native 2bpp tile
+// form (/gallery/pXXXXXXXX.bin: GalleryHeader + tile rows), each with a
+// half-scale PNG thumbnail made once at save time (/gallery/tXXXXXXXX.png).
+// Ids keep counting across reboots. They only restart when /gallery is wiped
+// or the volume reformatted, and that also picks a new volume tag, so
+// id + tag always names the same print.
+// The oldest prints go once GALLERY_MAX_IMAGES or GALLERY_MAX_BYTES is passed.
+// =============================================================================
+
+#define GALLERY_FORMAT 1
+
+struct GalleryHeader {
+    char magic[4];                  // "PTGB"
+    uint8_t format;                 // GALLERY_FORMAT
+    uint8_t palette;                // PRINT parameters
+    uint8_t margins;
+    uint8_t exposure;
+    uint16_t rows;                  // Tile rows that follow
+    uint16_t boot;                  // Boot number + uptime (no RTC)
+    uint32_t id;
+    uint32_t uptimeS;
+};
+
+static_assert(sizeof(GalleryHeader) == 20, "GalleryHeader layout changed");
+
+// In-RAM index entry; listing never touches flash
+struct GalleryEntry {
+    uint32_t id;
+    uint32_t uptimeS;
+    uint32_t bytes;                 // Print file + thumbnail on flash
+    uint16_t rows;
+    uint16_t boot;
+    uint8_t palette;
+    uint8_t margins;
+};
+
+// Load the index; needs LittleFS mounted (after journal_init)
+void gallery_init();
+
+// New prints in the printer FIFO not saved yet (always false on sim/replay)
+bool gallery_isDirty();
+
+// Save them; call only between sessions. Returns prints saved.
+int gallery_flush();
+
+// Bumped on every save and delete
+uint32_t gallery_getVersion();
+
+// Random tag picked when the gallery directory is created; part of every
+// image URL and ETag
+uint32_t gallery_volumeTag();
+
+// Web side (any task). Newest first; returns the count written.
+int gallery_list(int offset, GalleryEntry* out, int max, int* total, uint32_t* usedBytes);
+bool gallery_get(uint32_t id, GalleryEntry* out);
+bool gallery_remove(uint32_t id);
+void gallery_thumbPath(uint32_t id, char* buf, size_t len);
+
+// Open a print for reading its tile rows
+bool gallery_open(uint32_t id, File* file);
+bool gallery_readRow(File* file, int row, uint8_t* tiles);
+
+#endif // GALLERY_H
@@ -0,0 +1,66 @@
+#ifndef GEN_TRAITS_H
+#define GEN_TRAITS_H
+
+#include "trade_data.h"
+#include <stddef.h>
+
+// =============================================================================
+// Generation traits — wire layout and per-generation helpers
+// =============================================================================
+// Offsets are derived from the party block structs, relative to the first
+// byte after the preamble (i.e. as the bytes land in recvBlock). A new wire
+// layout (e.g. Japanese 6-char names) needs a block struct plus a
+// GenTraits specialization; the protocol engine in main.cpp is generic.
+
+template <typename B, typename M>
+struct PartyLayout {
+    typedef B Block;
+    typedef M Mon;
+
+    static constexpr uint16_t PREAMBLE_SIZE  = offsetof(B, playerName);
+    static constexpr uint16_t DATA_LENGTH    = sizeof(B) - PREAMBLE_SIZE;
+    static constexpr uint16_t COUNT_OFFSET   = offsetof(B, partyCount) - PREAMBLE_SIZE;
+    static constexpr uint16_t SPECIES_OFFSET = offsetof(B, partySpecies) - PREAMBLE_SIZE;
+    static constexpr uint16_t MON_OFFSET     = offsetof(B, pokemon) - PREAMBLE_SIZE;
+    static constexpr uint16_t OT_OFFSET      = offsetof(B, otNames) - PREAMBLE_SIZE;
+    static constexpr uint16_t NICK_OFFSET    = offsetof(B, nicknames) - PREAMBLE_SIZE;
+    static constexpr uint16_t MON_SIZE       = sizeof(M);
+    static constexpr uint16_t NAME_SIZE      = sizeof(B::otNames[0]);
+};
+
+template <Generation G> struct GenTraits;
+
+template <>
+struct GenTraits<GEN_1> : PartyLayout<Gen1PartyBlock, Gen1PartyMon> {
+    static const char* name() { return "Gen1"; }
+    static const char* speciesTag() { return "idx"; }   // Internal index
+    static const char* speciesName(uint8_t s) { return gen1_getSpeciesName(s); }
+    static void initBlock(Block* block) {}
+    static void buildDefaultParty(Block* block) { gen1_buildDefaultParty(block); }
+};
+
+template <>
+struct GenTraits<GEN_2> : PartyLayout<Gen2PartyBlock, Gen2PartyMon> {
+    static const char* name() { return "Gen2"; }
+    static const char* speciesTag() { return "dex"; }   // Pokedex number
+    static const char* speciesName(uint8_t s) { return gen2_getSpeciesName(s); }
+    static void initBlock(Block* block) {
+        block->playerId[0] = 0x00;
+        block->playerId[1] = 0x01;
+    }
+    static void buildDefaultParty(Block* block) { gen2_buildDefaultParty(block); }
+};
+
+// Layouts from pokered / pokecrystal
+static_assert(GenTraits<GEN_1>::DATA_LENGTH == 418, "Gen1 data length");
+static_assert(GenTraits<GEN_1>::MON_OFFSET == 19, "Gen1 party mons at 19");
+static_assert(GenTraits<GEN_1>::OT_OFFSET == 283, "Gen1 OT names at 283");
+static_assert(GenTraits<GEN_1>::NICK_OFFSET == 349, "Gen1 nicknames at 349");
+static_assert(GenTraits<GEN_2>::DATA_LENGTH == 444, "Gen2 data length");
+static_assert(GenTraits<GEN_2>::MON_OFFSET == 21, "Gen2 party mons at 21");
+static_assert(GenTraits<GEN_2>::OT_OFFSET == 309, "Gen2 OT names at 309");
+static_assert(GenTraits<GEN_2>::NICK_OFFSET == 375, "Gen2 nicknames at 375");
+static_assert(GenTraits<GEN_1>::SPECIES_OFFSET == 12 && GenTraits<GEN_2>::SPECIES_OFFSET == 12,
+              "Species list at 12");
+
+#endif // GEN_TRAITS_H
@@ -0,0 +1,234 @@
+#include "journal.h"
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// Trade Journal Implementation
+// Segment files are named by their first seq ("/journal/s0000002a"), so the
+// in-RAM segment table doubles as the seek index: seq -> file + offset.
+// =============================================================================
+
+#define JOURNAL_DIR       "/journal"
+#define JOURNAL_BOOT_PATH "/journal/boot"
+
+struct Segment {
+    uint32_t firstSeq;
+    uint16_t count;
+};
+
+static SemaphoreHandle_t journalMutex = nullptr;
+static bool ready = false;
+
+static Segment segments[JOURNAL_SEGMENTS];  // Oldest first
+static int segCount = 0;
+static bool tailSealed = false;             // Newest segment has a torn tail; don't append to it
+static uint16_t bootNumber = 0;
+static uint32_t nextSeq = 1;
+
+// Queued by the loop task, written by journal_flush (also the loop task)
+static JournalRecord pending[JOURNAL_PENDING];
+static int pendingCount = 0;
+
+static void segmentPath(char* buf, size_t len, uint32_t firstSeq) {
+    snprintf(buf, len, JOURNAL_DIR "/s%08x", (unsigned)firstSeq);
+}
+
+// Compaction: the log only ever loses its oldest whole segment
+static void dropOldestSegment() {
+    char path[32];
+    segmentPath(path, sizeof(path), segments[0].firstSeq);
+    LittleFS.remove(path);
+    memmove(&segments[0], &segments[1], (segCount - 1) * sizeof(Segment));
+    segCount--;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void journal_init() {
+    journalMutex = xSemaphoreCreateMutex();
+
+    if (!LittleFS.exists(JOURNAL_DIR)) LittleFS.mkdir(JOURNAL_DIR);
+
+    File f = LittleFS.open(JOURNAL_BOOT_PATH, "r");
+    if (f) {
+        f.read((uint8_t*)&bootNumber, sizeof(bootNumber));
+        f.close();
+    }
+    bootNumber++;
+    f = LittleFS.open(JOURNAL_BOOT_PATH, "w");
+    if (f) {
+        f.write((const uint8_t*)&bootNumber, sizeof(bootNumber));
+        f.close();
+    }
+
+    // Find segments (oldest first); any beyond JOURNAL_SEGMENTS are removed
+    uint32_t found[JOURNAL_SEGMENTS * 2];
+    int foundCount = 0;
+    File dir = LittleFS.open(JOURNAL_DIR);
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        const char* name = strrchr(entry.name(), '/');
+        name = name ? name + 1 : entry.name();
+        if (name[0] != 's' || entry.isDirectory()) continue;
+        if (foundCount == JOURNAL_SEGMENTS * 2) break;
+
+        uint32_t firstSeq = strtoul(name + 1, nullptr, 16);
+        int i = foundCount++;
+        while (i > 0 && found[i - 1] > firstSeq) {
+            found[i] = found[i - 1];
+            i--;
+        }
+        found[i] = firstSeq;
+    }
+    dir.close();
+
+    char path[32];
+    int skip = foundCount > JOURNAL_SEGMENTS ? foundCount - JOURNAL_SEGMENTS : 0;
+    for (int i = 0; i < foundCount; i++) {
+        segmentPath(path, sizeof(path), found[i]);
+        if (i < skip) {
+            LittleFS.remove(path);
+            continue;
+        }
+        File seg = LittleFS.open(path, "r");
+        size_t bytes = seg ? seg.size() : 0;
+        seg.close();
+
+        segments[segCount].firstSeq = found[i];
+        segments[segCount].count = bytes / sizeof(JournalRecord);
+        segCount++;
+        // A torn write leaves a partial record; start a fresh segment after it
+        tailSealed = (bytes % sizeof(JournalRecord)) != 0;
+    }
+
+    if (segCount > 0) {
+        const Segment* last = &segments[segCount - 1];
+        nextSeq = last->firstSeq + last->count;
+    }
+
+    ready = true;
+    Serial.printf("[JOURNAL] Boot %u, %d segments, next seq %u\n",
+                  bootNumber, segCount, (unsigned)nextSeq);
+}
+
+uint32_t journal_append(JournalRecord* rec) {
+    if (pendingCount == JOURNAL_PENDING) {
+        // More trades in one session than the queue holds; keep the newest
+        memmove(&pending[0], &pending[1], (JOURNAL_PENDING - 1) * sizeof(JournalRecord));
+        pendingCount--;
+        Serial.println("[JOURNAL] Queue full, oldest unflushed record dropped");
+    }
+    rec->seq = nextSeq++;
+    rec->uptimeS = millis() / 1000;
+    rec->boot = bootNumber;
+    pending[pendingCount++] = *rec;
+    return rec->seq;
+}
+
+// Records stay queued until the session ends, and the idle save runs before
+// that flush, so the record is always still here; nothing on flash is patched
+void journal_setSaved(uint32_t seq, uint8_t savedSlot, int16_t boxId) {
+    for (int i = 0; i < pendingCount; i++) {
+        if (pending[i].seq == seq) {
+            pending[i].savedSlot = savedSlot;
+            pending[i].boxId = boxId;
+            return;
+        }
+    }
+    Serial.printf("[JOURNAL] Record %u already written, save not recorded\n", (unsigned)seq);
+}
+
+bool journal_isDirty() {
+    return pendingCount > 0;
+}
+
+int journal_flush() {
+    if (!ready || pendingCount == 0) return 0;
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+
+    char path[32];
+    File f;
+    for (int i = 0; i < pendingCount; i++) {
+        const JournalRecord* rec = &pending[i];
+        Segment* tail = segCount ? &segments[segCount - 1] : nullptr;
+
+        if (!tail || tailSealed || tail->count >= JOURNAL_SEGMENT_RECORDS) {
+            if (f) f.close();
+            if (segCount == JOURNAL_SEGMENTS) dropOldestSegment();
+            tail = &segments[segCount++];
+            tail->firstSeq = rec->seq;
+            tail->count = 0;
+            tailSealed = false;
+            segmentPath(path, sizeof(path), tail->firstSeq);
+            f = LittleFS.open(path, "w");
+        } else if (!f) {
+            segmentPath(path, sizeof(path), tail->firstSeq);
+            f = LittleFS.open(path, "a");
+        }
+
+        if (f.write((const uint8_t*)rec, sizeof(JournalRecord)) == sizeof(JournalRecord)) {
+            tail->count++;
+        } else {
+            tailSealed = true;
+        }
+    }
+    if (f) f.close();
+
+    int written = pendingCount;
+    pendingCount = 0;
+    xSemaphoreGive(journalMutex);
+    return written;
+}
+
+uint16_t journal_bootNumber() {
+    return bootNumber;
+}
+
+uint32_t journal_endSeq() {
+    if (segCount == 0) return nextSeq - pendingCount;
+    const Segment* last = &segments[segCount - 1];
+    return last->firstSeq + last->count;
+}
+
+int journal_read(uint32_t beforeSeq, JournalRecord* out, int maxRecords) {
+    if (!ready) return 0;
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+
+    uint32_t end = journal_endSeq();
+    if (beforeSeq < end) end = beforeSeq;
+
+    int n = 0;
+    char path[32];
+    for (int s = segCount - 1; s >= 0 && n < maxRecords; s--) {
+        const Segment* seg = &segments[s];
+        if (seg->firstSeq >= end) continue;
+
+        uint32_t last = seg->firstSeq + seg->count;
+        if (last > end) last = end;
+        uint32_t take = last - seg->firstSeq;
+        if (take > (uint32_t)(maxRecords - n)) take = maxRecords - n;
+        uint32_t from = last - take;
+
+        segmentPath(path, sizeof(path), seg->firstSeq);
+        File f = LittleFS.open(path, "r");
+        if (!f) break;
+        f.seek((from - seg->firstSeq) * sizeof(JournalRecord));
+        size_t got = f.read((uint8_t*)&out[n], take * sizeof(JournalRecord)) / sizeof(JournalRecord);
+        f.close();
+
+        // Stored oldest first; hand back newest first
+        for (size_t a = 0, b = got; a + 1 < b; a++, b--) {
+            JournalRecord t = out[n + a];
+            out[n + a] = out[n + b - 1];
+            out[n + b - 1] = t;
+        }
+        n += got;
+        if (got < take) break;
+        end = from;
+    }
+
+    xSemaphoreGive(journalMutex);
+    return n;
+}
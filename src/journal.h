@@ -0,0 +1,56 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "config.h"
+
+// =============================================================================
+// Trade Journal
+// Append-only log of completed trades in a ring of LittleFS segment files.
+// Appends queue in RAM; journal_flush() writes them between sessions.
+// =============================================================================
+
+struct JournalRecord {
+    uint32_t seq;                   // Assigned by journal_append
+    uint32_t uptimeS;               // Seconds since boot (no RTC)
+    uint32_t sessionMs;             // Link session length at trade time
+    uint16_t boot;                  // Boot number, orders records across restarts
+    uint8_t gen;                    // Generation
+    uint8_t mode;                   // TradeMode
+    uint8_t sentSpecies;
+    uint8_t sentLevel;
+    uint8_t recvSpecies;
+    uint8_t recvLevel;
+    uint16_t recvOtId;
+    int16_t boxId;                  // Box database id, -1 if not archived
+    uint8_t savedSlot;
+    uint8_t recvOt[NAME_LENGTH];
+};
+
+static_assert(sizeof(JournalRecord) == 36, "JournalRecord layout changed");
+
+// Load the segment table and bump the boot number; needs LittleFS mounted
+void journal_init();
+
+// Queue a record (seq, uptime and boot are filled in). Returns its seq.
+uint32_t journal_append(JournalRecord* rec);
+
+// The received Pokemon of record seq was saved after the trade: fill in where.
+// Only patches the queued record; call before the end-of-session flush.
+void journal_setSaved(uint32_t seq, uint8_t savedSlot, int16_t boxId);
+
+// Write queued records; call only between sessions. Returns records written.
+int journal_flush();
+
+// True while records are waiting for journal_flush
+bool journal_isDirty();
+
+// Newest-first page of flushed records with seq < beforeSeq. Returns the count.
+int journal_read(uint32_t beforeSeq, JournalRecord* out, int maxRecords);
+
+// Seq the next flushed record will have (newest flushed seq + 1)
+uint32_t journal_endSeq();
+
+// This boot's number (after journal_init), for other boot + uptime timestamps
+uint16_t journal_bootNumber();
+
+#endif // JOURNAL_H
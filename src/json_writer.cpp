@@ -0,0 +1,127 @@
+#include "json_writer.h"
+
+// =============================================================================
+// JSON Writer Implementation
+// =============================================================================
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+void JsonWriter::begin(char* buffer, size_t capacity) {
+    buf = buffer;
+    cap = capacity;
+    len = 0;
+    overflow = capacity == 0;
+    depth = 0;
+    afterKey = false;
+    hasItems = 0;
+    if (capacity) buf[0] = '\0';
+}
+
+void JsonWriter::put(char c) {
+    if (len + 1 >= cap) {
+        overflow = true;
+        return;
+    }
+    buf[len++] = c;
+    buf[len] = '\0';
+}
+
+void JsonWriter::puts(const char* s) {
+    while (*s) put(*s++);
+}
+
+void JsonWriter::separator() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    uint16_t bit = 1u << depth;
+    if (hasItems & bit) put(',');
+    hasItems |= bit;
+}
+
+void JsonWriter::beginObject() {
+    separator();
+    put('{');
+    if (depth + 1 < JSON_MAX_DEPTH) depth++;
+    hasItems &= ~(1u << depth);
+}
+
+void JsonWriter::endObject() {
+    if (depth > 0) depth--;
+    put('}');
+}
+
+void JsonWriter::beginArray() {
+    separator();
+    put('[');
+    if (depth + 1 < JSON_MAX_DEPTH) depth++;
+    hasItems &= ~(1u << depth);
+}
+
+void JsonWriter::endArray() {
+    if (depth > 0) depth--;
+    put(']');
+}
+
+void JsonWriter::key(const char* k) {
+    separator();
+    put('"');
+    puts(k);
+    put('"');
+    put(':');
+    afterKey = true;
+}
+
+void JsonWriter::str(const char* s) {
+    separator();
+    put('"');
+    for (; *s; s++) {
+        char c = *s;
+        if (c == '"' || c == '\\') {
+            put('\\');
+            put(c);
+        } else if ((uint8_t)c < 0x20) {
+            puts("\\u00");
+            put(HEX_DIGITS[(uint8_t)c >> 4]);
+            put(HEX_DIGITS[c & 0xF]);
+        } else {
+            put(c);
+        }
+    }
+    put('"');
+}
+
+void JsonWriter::unum(uint32_t v) {
+    separator();
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n) put(digits[--n]);
+}
+
+void JsonWriter::num(int32_t v) {
+    if (v >= 0) {
+        unum((uint32_t)v);
+        return;
+    }
+    separator();
+    put('-');
+    afterKey = true;                // The digits belong to this value
+    unum(0u - (uint32_t)v);
+}
+
+void JsonWriter::fixed2(uint32_t x100) {
+    unum(x100 / 100);
+    put('.');
+    put('0' + (x100 / 10) % 10);
+    put('0' + x100 % 10);
+}
+
+void JsonWriter::boolean(bool b) {
+    separator();
+    puts(b ? "true" : "false");
+}
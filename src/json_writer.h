@@ -0,0 +1,57 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// Fixed-buffer JSON writer
+// =============================================================================
+// Writes into a caller-owned buffer, inserting commas itself; never touches the
+// heap. Output that doesn't fit is cut off and ok() turns false, so a handler
+// can answer with an error instead of sending half a document. The buffer is
+// always NUL-terminated.
+
+#define JSON_MAX_DEPTH 16
+
+struct JsonWriter {
+    char* buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    uint8_t depth;
+    bool afterKey;                  // Next value belongs to the key just written
+    uint16_t hasItems;              // Bit per depth: a value was already written there
+
+    void begin(char* buffer, size_t capacity);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const char* k);
+
+    // Values (in an array, or after key())
+    void str(const char* s);        // Quoted and escaped
+    void num(int32_t v);
+    void unum(uint32_t v);
+    void fixed2(uint32_t x100);     // 1234 -> 12.34
+    void boolean(bool b);
+
+    // key + value
+    void fieldStr(const char* k, const char* s)   { key(k); str(s); }
+    void fieldInt(const char* k, int32_t v)       { key(k); num(v); }
+    void fieldUint(const char* k, uint32_t v)     { key(k); unum(v); }
+    void fieldBool(const char* k, bool b)         { key(k); boolean(b); }
+
+    bool ok() const { return !overflow; }
+    const char* c_str() const { return buf; }
+    size_t length() const { return len; }
+
+private:
+    void separator();
+    void put(char c);
+    void puts(const char* s);
+};
+
+#endif // JSON_WRITER_H
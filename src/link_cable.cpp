@@ -1,75 +1,210 @@
 #include "link_cable.h"
+#include "link_transport.h"
+#include "link_timing.h"
 
-static unsigned long lastClockTime = 0;
+// =============================================================================
+// Transport selection
+// =============================================================================
 
-void link_init() {
-    pinMode(PIN_MOSI, OUTPUT);
-    pinMode(PIN_MISO, INPUT);
-    pinMode(PIN_SCLK, INPUT);
-    digitalWrite(PIN_MOSI, LOW);
-    lastClockTime = millis();
-}
-
-int link_transferByte(uint8_t sendByte) {
-    uint8_t received = 0;
-    unsigned long timeout;
-
-    for (int bit = 7; bit >= 0; bit--) {
-        // Wait for SCLK to go LOW (falling edge)
-        timeout = micros();
-        while (READ_GPIO(PIN_SCLK)) {
-            if ((micros() - timeout) > CLOCK_TIMEOUT_US) {
-                return -1; // Timeout
-            }
-        }
+#if LINK_BACKEND == LINK_BACKEND_SPI
+static const LinkTransport* transport = &linkTransportSpi;
+#elif LINK_BACKEND == LINK_BACKEND_SIM
+static const LinkTransport* transport = &linkTransportSim;
+#elif LINK_BACKEND == LINK_BACKEND_REPLAY
+static const LinkTransport* transport = &linkTransportReplay;
+#else
+static const LinkTransport* transport = &linkTransportGpio;
+#endif
 
-        // Set MOSI bit while clock is LOW
-        if (sendByte & 0x80) {
-            WRITE_GPIO_HIGH(PIN_MOSI);
-        } else {
-            WRITE_GPIO_LOW(PIN_MOSI);
-        }
-        sendByte <<= 1;
-
-        // Wait for SCLK to go HIGH (rising edge)
-        timeout = micros();
-        while (!READ_GPIO(PIN_SCLK)) {
-            if ((micros() - timeout) > CLOCK_TIMEOUT_US) {
-                return -1; // Timeout
-            }
-        }
+// =============================================================================
+// Overhead accounting — CPU cycles spent inside the transport per byte
+// (excludes time blocked in wait())
+// =============================================================================
+
+static uint32_t statBytes = 0;
+static uint64_t statCycles = 0;
+static uint32_t statMaxCycles = 0;
+static uint32_t byteCycles = 0;   // Cycles for the byte in flight
+
+// Turnaround: exchange completed (transport timestamp) -> response staged
+static uint32_t byteDoneUs = 0;
+static uint64_t statTurnaroundUs = 0;
+static uint32_t statMaxTurnaroundUs = 0;
+
+// Realign: bytes queued before link_realign() still arrive with the old
+// boundary. The first byte to complete after it may have started before it;
+// the one after that started after it and so has the slip applied.
+static uint32_t realignUs = 0;
+static bool realigning = false;
+static bool realignStraddled = false;
+
+static inline uint32_t cycleCount() {
+    return ESP.getCycleCount();
+}
+
+static inline uint32_t cyclesToNs(uint64_t cycles) {
+    return (uint32_t)(cycles * 1000 / getCpuFrequencyMhz());
+}
+
+// =============================================================================
+// Clock estimate -> timeouts
+// =============================================================================
 
-        // Read MISO bit on rising edge
-        received |= (READ_GPIO(PIN_MISO) << bit);
+// The session timeout stays IDLE_TIMEOUT_MS. A pause that long ended the
+// session, so the first edge after it isn't sampled, and each session starts
+// over from the fixed values (link_resetTiming).
+LinkTimingState linkTiming = { 0, 0, 0, 0xFFFFFFFF, 0, CLOCK_TIMEOUT_US, IDLE_TIMEOUT_MS * 1000UL, false };
+
+struct TimingProfile {
+    const char* name;
+    uint32_t maxBitUs;          // Bit periods up to this belong to the profile
+    uint32_t flushMinMs;
+};
+
+static const TimingProfile PROFILES[] = {
+    { "cgb-fast", 20,         5  },     // 262144 / 524288 Hz: 3.8 / 1.9 us bits
+    { "cgb",      90,         10 },     // 16384 Hz: 61 us bits
+    { "dmg",      0xFFFFFFFF, 20 },     // 8192 Hz: 122 us bits
+};
+
+static const TimingProfile* profile = nullptr;    // Null = fixed timeouts
+static uint32_t flushIdleMs = FLUSH_IDLE_MS;
+static uint32_t sinceTimingUpdate = 0;
+
+static uint32_t clampU(uint32_t v, uint32_t lo, uint32_t hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+static uint32_t estimatedBitUs() {
+    if (linkTiming.bitUsX16) return linkTiming.bitUsX16 >> 4;
+    return (linkTiming.minByteUs != 0xFFFFFFFF) ? linkTiming.minByteUs / 8 : 0;
+}
+
+static void updateTiming() {
+    uint32_t bitUs = estimatedBitUs();
+    if (bitUs == 0 || linkTiming.gaps < LINK_TIMING_MIN_GAPS) return;
+
+    const TimingProfile* p = PROFILES;
+    while (bitUs > p->maxBitUs) p++;
+    if (profile && p != profile) {
+        link_resetTiming();                         // Another master; old pauses don't apply
+        return;
     }
+    profile = p;
 
-    lastClockTime = millis();
-    return received;
+    uint32_t peakMs = linkTiming.peakGapUs / 1000 + 1;
+    flushIdleMs = clampU(LINK_FLUSH_GAPS * peakMs, p->flushMinMs, FLUSH_IDLE_MS);
+    linkTiming.partialUs = clampU(LINK_PARTIAL_BITS * bitUs, LINK_PARTIAL_MIN_US, CLOCK_TIMEOUT_US);
 }
 
-bool link_waitForActivity(uint32_t timeout_ms) {
-    unsigned long start = millis();
-    int lastState = READ_GPIO(PIN_SCLK);
+// =============================================================================
+// Public API
+// =============================================================================
+
+void link_init() {
+    transport->init();
+}
 
-    while ((millis() - start) < timeout_ms) {
-        int currentState = READ_GPIO(PIN_SCLK);
-        if (currentState != lastState) {
-            lastClockTime = millis();
-            return true;
+int link_readByte(uint8_t* sent, uint32_t wait_ms) {
+    uint32_t start = cycleCount();
+    int received = transport->poll(sent, &byteDoneUs);
+    if (received < 0 && wait_ms > 0) {
+        transport->wait(wait_ms);
+        start = cycleCount();
+        received = transport->poll(sent, &byteDoneUs);
+    }
+    if (received >= 0) {
+        byteCycles = cycleCount() - start;
+        if (realigning && (int32_t)(byteDoneUs - realignUs) > 0) {
+            if (realignStraddled) realigning = false;
+            realignStraddled = true;
+        }
+        if (++sinceTimingUpdate >= 16) {
+            sinceTimingUpdate = 0;
+            updateTiming();
         }
     }
-    return false;
+    return received;
+}
+
+void link_wake() {
+    if (transport->wake) transport->wake();
+}
+
+void link_setResponse(uint8_t sendByte) {
+    uint32_t start = cycleCount();
+    transport->setResponse(sendByte);
+    if (byteCycles == 0) return; // Not answering a byte (e.g. reset)
+
+    uint32_t total = byteCycles + (cycleCount() - start);
+    uint32_t turnaround = micros() - byteDoneUs;
+    byteCycles = 0;
+    statBytes++;
+    statCycles += total;
+    if (total > statMaxCycles) statMaxCycles = total;
+    statTurnaroundUs += turnaround;
+    if (turnaround > statMaxTurnaroundUs) statMaxTurnaroundUs = turnaround;
 }
 
 bool link_isIdle(uint32_t idle_ms) {
-    // Check for any clock transitions
-    static int prevClockState = -1;
-    int currentState = READ_GPIO(PIN_SCLK);
+    return transport->idleUs() >= idle_ms * 1000UL;
+}
 
-    if (prevClockState >= 0 && currentState != prevClockState) {
-        lastClockTime = millis();
-    }
-    prevClockState = currentState;
+uint32_t link_getOverruns() {
+    return transport->overruns();
+}
+
+bool link_realign(uint8_t bits) {
+    if (!transport->realign) return false;
+    transport->realign(bits);
+    realignUs = micros();
+    realigning = true;
+    realignStraddled = false;
+    return true;
+}
+
+bool link_isRealigning() {
+    return realigning;
+}
+
+void link_getStats(LinkStats* out) {
+    out->backend = transport->name;
+    out->bytes = statBytes;
+    out->overruns = transport->overruns();
+    out->avgOverheadNs = statBytes ? cyclesToNs(statCycles / statBytes) : 0;
+    out->maxOverheadNs = cyclesToNs(statMaxCycles);
+    out->avgTurnaroundUs = statBytes ? (uint32_t)(statTurnaroundUs / statBytes) : 0;
+    out->maxTurnaroundUs = statMaxTurnaroundUs;
+}
+
+void link_resetStats() {
+    statBytes = 0;
+    statCycles = 0;
+    statMaxCycles = 0;
+    statTurnaroundUs = 0;
+    statMaxTurnaroundUs = 0;
+}
+
+// Read-only: the estimate is only recomputed by the loop task (link_readByte)
+void link_getTiming(LinkTiming* out) {
+    uint32_t gapUs = linkTiming.gapUsX16 >> 4;
+    out->profile = profile ? profile->name : "fixed";
+    out->bitNs = (uint32_t)((uint64_t)linkTiming.bitUsX16 * 1000 / 16);
+    out->gapUs = gapUs;
+    out->peakGapUs = linkTiming.peakGapUs;
+    out->partialTimeoutUs = linkTiming.partialUs;
+    out->flushIdleMs = flushIdleMs;
+    out->slackUs = linkTiming.gaps ? (int32_t)gapUs - (int32_t)statMaxTurnaroundUs : 0;
+}
+
+void link_resetTiming() {
+    profile = nullptr;
+    flushIdleMs = FLUSH_IDLE_MS;
+    sinceTimingUpdate = 0;
+    linkTiming.partialUs = CLOCK_TIMEOUT_US;
+    linkTiming.resetPending = true;
+}
 
-    return (millis() - lastClockTime) >= idle_ms;
+uint32_t link_flushIdleMs() {
+    return flushIdleMs;
 }
@@ -3,20 +3,82 @@
 
 #include "config.h"
 
-// Initialize link cable GPIO pins
+// Initialize the link transport selected by LINK_BACKEND.
+// Must be called from the task that will call link_readByte().
 void link_init();
 
-// Exchange one byte with the Game Boy (blocking).
-// Sends `sendByte` while simultaneously receiving a byte.
-// Returns the received byte, or -1 on timeout.
-int link_transferByte(uint8_t sendByte);
+// Fetch the next completed byte exchange from the transport.
+// Blocks for at most wait_ms if nothing is pending (0 = don't block).
+// Returns the received byte and stores the byte we shifted out during the
+// same transfer in *sent, or returns -1 if no byte arrived in time.
+int link_readByte(uint8_t* sent, uint32_t wait_ms);
 
-// Wait for any clock activity within timeout_ms.
-// Returns true if clock edge detected, false on timeout.
-bool link_waitForActivity(uint32_t timeout_ms);
+// Make a link_readByte() blocked in another task return early (where the
+// transport supports it), so the loop picks up new commands promptly.
+void link_wake();
+
+// Stage the byte to shift out on the next transfer.
+void link_setResponse(uint8_t sendByte);
 
 // Check if the clock has been idle for at least idle_ms milliseconds.
-// Non-blocking: returns true if idle, false if clock is still active.
+// Non-blocking: based on the timestamp of the last clock activity.
 bool link_isIdle(uint32_t idle_ms);
 
+// Number of completed bytes dropped because the loop fell behind.
+uint32_t link_getOverruns();
+
+// Bytes are arriving `bits` (1-7) late after a missed or extra clock edge:
+// shift the transport's byte boundary back. False if it can't.
+bool link_realign(uint8_t bits);
+
+// True until the byte last read by link_readByte() started after the last
+// link_realign(): bytes still queued from before it keep the old boundary.
+bool link_isRealigning();
+
+// =============================================================================
+// Transport overhead accounting
+// =============================================================================
+
+struct LinkStats {
+    const char* backend;      // Transport name ("gpio", "spi", "sim", "replay")
+    uint32_t bytes;           // Exchanges delivered to the protocol layer
+    uint32_t overruns;        // Exchanges dropped by the transport (since boot)
+    uint32_t avgOverheadNs;   // Mean time spent in poll + setResponse per byte
+    uint32_t maxOverheadNs;   // Worst single byte
+    uint32_t avgTurnaroundUs; // Mean time from byte complete to response staged
+    uint32_t maxTurnaroundUs; // Worst-case byte turnaround
+};
+
+void link_getStats(LinkStats* out);
+void link_resetStats();
+
+// =============================================================================
+// Clock estimate — timeouts follow the master's measured clock
+// =============================================================================
+// Until LINK_TIMING_MIN_GAPS pauses have been measured (and on transports
+// that see no edges) the fixed IDLE_TIMEOUT_MS / FLUSH_IDLE_MS /
+// CLOCK_TIMEOUT_US apply; after that they are derived from the estimate and
+// the profile its bit period falls in, and the fixed values are ceilings.
+// The session timeout is always IDLE_TIMEOUT_MS. link_getTiming() only
+// reads, so any task may call it.
+
+struct LinkTiming {
+    const char* profile;      // "dmg", "cgb", "cgb-fast", or "fixed" until measured
+    uint32_t bitNs;           // Estimated bit period (0 = no edges seen)
+    uint32_t gapUs;           // Estimated pause between bytes
+    uint32_t peakGapUs;       // Longest pause seen
+    uint32_t partialTimeoutUs;
+    uint32_t flushIdleMs;
+    int32_t slackUs;          // Pause minus worst turnaround: room left to stage a response
+};
+
+void link_getTiming(LinkTiming* out);
+
+// Session over: back to the fixed timeouts until the next one is measured
+// (loop task only)
+void link_resetTiming();
+
+// Quiet this long = safe to do slow work (debug flushes) between bytes
+uint32_t link_flushIdleMs();
+
 #endif // LINK_CABLE_H
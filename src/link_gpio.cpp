@@ -0,0 +1,145 @@
+#include "config.h"
+#include "link_transport.h"
+#include "spsc_ring.h"
+#include "link_timing.h"
+
+// =============================================================================
+// GPIO Transport — interrupt-driven shift register
+// =============================================================================
+// The Game Boy is the clock master. Each SCLK falling edge shifts our next
+// bit out on MOSI; each rising edge samples MISO. After eight rising edges the
+// ISR pushes the completed exchange into a lock-free ring and wakes loop().
+
+struct LinkExchange {
+    uint32_t doneUs;
+    uint8_t sent;
+    uint8_t recv;
+};
+
+static SpscRing<LinkExchange, LINK_RING_SIZE> ring;
+static TaskHandle_t consumerTask = nullptr;
+
+static volatile uint8_t nextTx = 0x00;      // Staged by setResponse()
+static volatile uint32_t lastEdgeUs = 0;
+static uint32_t lastRiseUs = 0;             // ISR-private, for the clock estimate
+static volatile uint32_t overrunCount = 0;
+static volatile uint8_t pendingSlip = 0;    // Set by realign(), taken at the next byte
+
+// ISR-private shift state
+static uint8_t txShift = 0;
+static uint8_t txByte = 0;
+static uint8_t rxShift = 0;
+static uint8_t bitCount = 0;
+
+static void IRAM_ATTR onClockEdge() {
+    uint32_t now = micros();
+
+    // A byte that stalled mid-way is stale; start over on this edge
+    if (bitCount != 0 && (now - lastEdgeUs) > linkTiming.partialUs) {
+        bitCount = 0;
+    }
+    lastEdgeUs = now;
+
+    if (!READ_GPIO(PIN_SCLK)) {
+        // Falling edge: latch the staged byte on bit 7, then present next bit
+        if (bitCount == 0) {
+            txByte = nextTx;
+            txShift = txByte;
+        }
+        if (txShift & 0x80) {
+            WRITE_GPIO_HIGH(PIN_MOSI);
+        } else {
+            WRITE_GPIO_LOW(PIN_MOSI);
+        }
+        txShift <<= 1;
+        return;
+    }
+
+    // Rising edge: sample MISO
+    rxShift = (rxShift << 1) | READ_GPIO(PIN_MISO);
+    if (bitCount == 0) {
+        linkTiming_firstBit(now - lastRiseUs);
+        if (pendingSlip) {
+            bitCount = pendingSlip;         // This byte ends pendingSlip bits early
+            pendingSlip = 0;
+        }
+    } else {
+        linkTiming_bit(now - lastRiseUs);
+    }
+    lastRiseUs = now;
+    if (++bitCount < 8) return;
+    bitCount = 0;
+
+    LinkExchange ex = { now, txByte, rxShift };
+    if (!ring.push(ex)) {
+        overrunCount++;
+        return;
+    }
+
+    if (consumerTask) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(consumerTask, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+}
+
+// =============================================================================
+// Transport ops
+// =============================================================================
+
+static void gpioInit() {
+    pinMode(PIN_MOSI, OUTPUT);
+    pinMode(PIN_MISO, INPUT);
+    pinMode(PIN_SCLK, INPUT);
+    digitalWrite(PIN_MOSI, LOW);
+
+    consumerTask = xTaskGetCurrentTaskHandle();
+    lastEdgeUs = micros();
+    attachInterrupt(digitalPinToInterrupt(PIN_SCLK), onClockEdge, CHANGE);
+}
+
+static int gpioPoll(uint8_t* sent, uint32_t* doneUs) {
+    LinkExchange ex;
+    if (!ring.pop(&ex)) return -1;
+    *sent = ex.sent;
+    *doneUs = ex.doneUs;
+    return ex.recv;
+}
+
+static void gpioWait(uint32_t wait_ms) {
+    if (ring.empty()) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+    }
+}
+
+static void gpioWake() {
+    if (consumerTask) xTaskNotifyGive(consumerTask);
+}
+
+static void gpioSetResponse(uint8_t sendByte) {
+    nextTx = sendByte;
+}
+
+static uint32_t gpioIdleUs() {
+    return micros() - lastEdgeUs;
+}
+
+static uint32_t gpioOverruns() {
+    return overrunCount;
+}
+
+static void gpioRealign(uint8_t bits) {
+    pendingSlip = bits & 7;
+}
+
+const LinkTransport linkTransportGpio = {
+    "gpio",
+    gpioInit,
+    gpioPoll,
+    gpioWait,
+    gpioWake,
+    gpioSetResponse,
+    gpioIdleUs,
+    gpioOverruns,
+    gpioRealign
+};
@@ -0,0 +1,426 @@
+#include "link_master.h"
+#include "link_cable.h"
+#include "debug_log.h"
+#include <string.h>
+#if LINK_BACKEND == LINK_BACKEND_GPIO
+#include <driver/spi_master.h>
+#include <hal/spi_ll.h>
+#include <soc/soc.h>
+#include <soc/spi_struct.h>
+#endif
+
+// =============================================================================
+// Link Master Implementation
+// =============================================================================
+// Mode 3 like the Game Boy: SCLK idles high, we change our data bit on the
+// falling edge and sample the slave's on the rising edge, MSB first.
+//
+// At 8 and 16 kHz every timer interrupt makes one clock edge. At the CGB fast
+// clocks a half bit is 1-2 us, less than interrupt entry takes, so GPSPI2
+// runs as an SPI master and shifts the bits itself. The timer then fires once
+// per byte slot: the ISR collects the byte the peripheral finished in the last
+// slot and starts the next. It only touches registers and never waits, and
+// the timer still sets the byte rate and the gaps between bytes.
+
+const uint32_t LINK_CLOCK_HZ[LINK_CLOCK_RATES] = { 8192, 16384, 262144, 524288 };
+
+#define TIMER_DIVIDER   2                           // 80 MHz APB -> 40 MHz ticks
+#define TIMER_TICK_HZ   (80000000 / TIMER_DIVIDER)
+
+static hw_timer_t* timer = nullptr;
+static TaskHandle_t waiter = nullptr;
+static bool active = false;
+static LinkClockRate rate = LINK_CLOCK_8K;
+static bool perByte = false;
+static uint32_t halfCycles = 0;                     // CPU cycles per half bit
+static uint32_t clockHz = 0;                        // Per-byte mode: what GPSPI2 really runs at
+static bool inFlight = false;                       // Per-byte mode: a byte is shifting
+static uint32_t gapEdges = 0;                       // Per-edge mode: idle half bits between bytes
+
+// Transfer in flight; the ISR owns these while running is set
+static const uint8_t* txData = nullptr;
+static uint8_t* rxData = nullptr;
+static int xferLen = 0;
+static volatile int xferDone = 0;
+static volatile bool running = false;
+static uint8_t txShift = 0;
+static uint8_t rxShift = 0;
+static uint32_t edge = 0;                           // 0-15 inside a byte, then the gap
+static uint32_t firstEdgeCycles = 0;
+static uint32_t lastRiseCycles = 0;
+
+// Bit timing, in CPU cycles
+static uint32_t bitCount = 0;
+static uint64_t bitSum = 0;
+static uint32_t bitMin = 0;
+static uint32_t bitMax = 0;
+static uint32_t lateBits = 0;
+
+static LinkMasterStats stats[LINK_CLOCK_RATES];
+
+static inline uint32_t cycles() {
+    return ESP.getCycleCount();
+}
+
+// =============================================================================
+// Pins — real ones on the GPIO backend, a virtual slave in the simulator
+// =============================================================================
+
+#if LINK_BACKEND == LINK_BACKEND_SIM
+
+// Shifts out simPattern(n) for byte n and checks it receives simExpect[n]
+static const uint8_t* simExpect = nullptr;
+static uint8_t simMosi = 0;
+static uint8_t simMiso = 0;
+static uint8_t simOut = 0;
+static uint8_t simIn = 0;
+static uint8_t simBits = 0;
+static bool simClock = true;
+static uint32_t simBytes = 0;
+static uint32_t simErrors = 0;
+
+static inline uint8_t simPattern(uint32_t n) {
+    return (uint8_t)(n * 37 + 0xA5);
+}
+
+static inline void IRAM_ATTR clockLow() {
+    if (!simClock) simErrors++;                     // Two falling edges in a row
+    simClock = false;
+    if (simBits == 0) simOut = simPattern(simBytes);
+    simMiso = simOut >> 7;
+    simOut <<= 1;
+}
+
+static inline void IRAM_ATTR clockHigh() {
+    if (simClock) simErrors++;
+    simClock = true;
+    simIn = (simIn << 1) | simMosi;
+    if (++simBits < 8) return;
+    simBits = 0;
+    if (simExpect && simIn != simExpect[simBytes]) simErrors++;
+    simBytes++;
+}
+
+static inline void IRAM_ATTR putBit(uint8_t bit) { simMosi = bit; }
+static inline uint8_t IRAM_ATTR getBit() { return simMiso; }
+
+// Per-byte mode stands in for GPSPI2: whole bytes, no edges to check
+static inline void IRAM_ATTR byteStart(uint8_t tx) {
+    if (simExpect && tx != simExpect[simBytes]) simErrors++;
+    simOut = simPattern(simBytes++);
+}
+
+static inline bool IRAM_ATTR byteDone() { return true; }
+static inline uint8_t IRAM_ATTR byteRead() { return simOut; }
+
+static bool pinsTake(bool fast) {
+    simClock = true;
+    simBits = 0;
+    simBytes = 0;
+    simErrors = 0;
+    return true;
+}
+
+static void pinsRelease(bool fast) {}
+
+#elif LINK_BACKEND == LINK_BACKEND_GPIO
+
+static inline void IRAM_ATTR clockLow() { WRITE_GPIO_LOW(PIN_SCLK); }
+static inline void IRAM_ATTR clockHigh() { WRITE_GPIO_HIGH(PIN_SCLK); }
+
+static inline void IRAM_ATTR putBit(uint8_t bit) {
+    if (bit) {
+        WRITE_GPIO_HIGH(PIN_MOSI);
+    } else {
+        WRITE_GPIO_LOW(PIN_MOSI);
+    }
+}
+
+static inline uint8_t IRAM_ATTR getBit() { return READ_GPIO(PIN_MISO); }
+
+// Per-byte mode: GPSPI2 master on the same pins. The slave backend would own
+// GPSPI2, but master mode isn't offered there.
+static inline void IRAM_ATTR byteStart(uint8_t tx) {
+    spi_ll_clear_int_stat(&GPSPI2);
+    spi_ll_write_buffer(&GPSPI2, &tx, 8);
+    spi_ll_apply_config(&GPSPI2);
+    spi_ll_user_start(&GPSPI2);
+}
+
+static inline bool IRAM_ATTR byteDone() { return spi_ll_usr_is_done(&GPSPI2); }
+
+static inline uint8_t IRAM_ATTR byteRead() {
+    uint8_t rx;
+    spi_ll_read_buffer(&GPSPI2, &rx, 8);
+    return rx;
+}
+
+// The driver only routes the pins and enables the peripheral; transfers go
+// straight to the registers so the timer ISR can start them
+static bool spiTake(uint32_t hz) {
+    spi_bus_config_t bus;
+    memset(&bus, 0, sizeof(bus));
+    bus.mosi_io_num = PIN_MOSI;
+    bus.miso_io_num = PIN_MISO;
+    bus.sclk_io_num = PIN_SCLK;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    if (spi_bus_initialize(SPI2_HOST, &bus, SPI_DMA_DISABLED) != ESP_OK) return false;
+
+    spi_dev_t* hw = &GPSPI2;
+    spi_ll_master_init(hw);
+    spi_ll_master_set_mode(hw, 3);                  // SCLK idles high, sample on rising
+    spi_ll_set_half_duplex(hw, false);
+    spi_ll_set_sio_mode(hw, 0);
+    spi_ll_set_tx_lsbfirst(hw, false);
+    spi_ll_set_rx_lsbfirst(hw, false);
+    spi_ll_set_command_bitlen(hw, 0);
+    spi_ll_set_addr_bitlen(hw, 0);
+    spi_ll_set_dummy(hw, 0);
+    spi_ll_master_set_cs_setup(hw, 0);
+    spi_ll_master_set_cs_hold(hw, 0);
+    spi_ll_enable_mosi(hw, 1);
+    spi_ll_enable_miso(hw, 1);
+    spi_ll_set_mosi_bitlen(hw, 8);
+    spi_ll_set_miso_bitlen(hw, 8);
+
+    spi_ll_clock_val_t clk;
+    clockHz = spi_ll_master_cal_clock(APB_CLK_FREQ, hz, 128, &clk);
+    spi_ll_master_set_clock_by_reg(hw, &clk);
+    return true;
+}
+
+static bool pinsTake(bool fast) {
+    detachInterrupt(digitalPinToInterrupt(PIN_SCLK));
+    if (fast) return spiTake(LINK_CLOCK_HZ[rate]);
+    digitalWrite(PIN_SCLK, HIGH);
+    pinMode(PIN_SCLK, OUTPUT);
+    return true;
+}
+
+static void pinsRelease(bool fast) {
+    if (fast) spi_bus_free(SPI2_HOST);
+    pinMode(PIN_SCLK, INPUT);
+    link_init();                                    // Pins back to GPIO, SCLK interrupt re-armed
+}
+
+#else
+
+static inline void clockLow() {}
+static inline void clockHigh() {}
+static inline void putBit(uint8_t) {}
+static inline uint8_t getBit() { return 0; }
+static inline void byteStart(uint8_t) {}
+static inline bool byteDone() { return true; }
+static inline uint8_t byteRead() { return 0; }
+static bool pinsTake(bool fast) { return false; }  // SCLK belongs to a peripheral or a file
+static void pinsRelease(bool fast) {}
+
+#endif
+
+// =============================================================================
+// Timer ISR
+// =============================================================================
+
+static inline void IRAM_ATTR noteRise(uint32_t now) {
+    if (edge > 1) {                                 // Not the first bit of the byte
+        uint32_t bit = now - lastRiseCycles;
+        bitCount++;
+        bitSum += bit;
+        if (bit < bitMin) bitMin = bit;
+        if (bit > bitMax) bitMax = bit;
+        int32_t off = (int32_t)bit - (int32_t)(2 * halfCycles);
+        if (off > (int32_t)(halfCycles / 2) || -off > (int32_t)(halfCycles / 2)) lateBits++;
+    }
+    lastRiseCycles = now;
+}
+
+static inline void IRAM_ATTR finishByte() {
+    if (rxData) rxData[xferDone] = rxShift;
+    if (++xferDone < xferLen) return;
+    running = false;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(waiter, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+// One clock edge per interrupt
+static void IRAM_ATTR onEdge() {
+    if (!running) return;
+    if (edge >= 16) {
+        if (edge - 16 < gapEdges) {
+            edge++;
+            return;
+        }
+        edge = 0;
+    }
+
+    if ((edge & 1) == 0) {
+        if (edge == 0) {
+            txShift = txData[xferDone];
+            if (xferDone == 0) firstEdgeCycles = cycles();
+        }
+        clockLow();
+        putBit(txShift >> 7);
+        txShift <<= 1;
+    } else {
+        clockHigh();
+        rxShift = (rxShift << 1) | getBit();
+        noteRise(cycles());
+    }
+    if (++edge == 16) finishByte();
+}
+
+// One byte per interrupt: collect the byte the peripheral shifted during the
+// last slot, start the next. A byte still shifting is left for the next slot
+// and counted late; that only happens if the slot is shorter than 8 bits.
+static void IRAM_ATTR onByte() {
+    if (!running) return;
+    uint32_t now = cycles();
+    if (inFlight) {
+        if (!byteDone()) {
+            lateBits++;
+            return;
+        }
+        inFlight = false;
+        rxShift = byteRead();
+        lastRiseCycles = now;
+        finishByte();
+        if (!running) return;
+    }
+    if (xferDone == 0) firstEdgeCycles = now;
+    byteStart(txData[xferDone]);
+    inFlight = true;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+bool link_master_begin(LinkClockRate r, uint32_t gapUs) {
+    if (active || r >= LINK_CLOCK_RATES) return false;
+
+    rate = r;
+    uint32_t hz = LINK_CLOCK_HZ[r];
+    perByte = 1000000UL / (2 * hz) < LINK_MASTER_MIN_HALF_US;
+    clockHz = hz;
+    if (!pinsTake(perByte)) return false;
+    halfCycles = getCpuFrequencyMhz() * 1000000UL / (2 * clockHz);
+    gapEdges = (uint32_t)(((uint64_t)gapUs * 2 * hz + 999999) / 1000000);
+
+    uint64_t alarm = perByte
+        ? (uint64_t)TIMER_TICK_HZ * 8 / hz + (uint64_t)gapUs * (TIMER_TICK_HZ / 1000000)
+        : TIMER_TICK_HZ / (2 * hz);
+    timer = timerBegin(LINK_MASTER_TIMER, TIMER_DIVIDER, true);
+    timerAttachInterrupt(timer, perByte ? onByte : onEdge, true);
+    timerAlarmWrite(timer, alarm, true);
+
+    memset(&stats[r], 0, sizeof(stats[r]));
+    stats[r].hz = hz;
+    stats[r].clockHz = clockHz;
+    stats[r].perByte = perByte;
+    bitCount = 0;
+    bitSum = 0;
+    bitMin = 0xFFFFFFFF;
+    bitMax = 0;
+    lateBits = 0;
+
+    waiter = xTaskGetCurrentTaskHandle();
+    active = true;
+    return true;
+}
+
+int link_master_transfer(const uint8_t* tx, uint8_t* rx, int len, uint32_t timeout_ms) {
+    if (!active || len <= 0) return 0;
+
+    txData = tx;
+    rxData = rx;
+    xferLen = len;
+    xferDone = 0;
+    inFlight = false;
+    edge = 16 + gapEdges;                           // Start on the first edge
+    ulTaskNotifyTake(pdTRUE, 0);
+    running = true;
+    timerWrite(timer, 0);
+    timerAlarmEnable(timer);
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    running = false;
+    timerAlarmDisable(timer);
+
+    int done = xferDone;
+    if (done > 0) {
+        LinkMasterStats* s = &stats[rate];
+        uint32_t mhz = getCpuFrequencyMhz();
+        s->bytes += done;
+        // Per-edge: last rising edge plus the high half bit. Per-byte: the
+        // slot that collected the last byte.
+        s->elapsedUs += (lastRiseCycles + (perByte ? 0 : halfCycles) - firstEdgeCycles) / mhz;
+        s->bytesPerSec = s->elapsedUs ? (uint32_t)((uint64_t)s->bytes * 1000000 / s->elapsedUs) : 0;
+        if (perByte) {
+            // The peripheral times the bits off its own divider
+            s->bitAvgNs = s->bitMinNs = s->bitMaxNs = 1000000000UL / clockHz;
+        } else {
+            s->bitAvgNs = bitCount ? (uint32_t)(bitSum * 1000 / bitCount / mhz) : 0;
+            s->bitMinNs = bitCount ? bitMin * 1000 / mhz : 0;
+            s->bitMaxNs = bitMax * 1000 / mhz;
+        }
+        s->lateBits = lateBits;
+    }
+    if (done < len) {
+        LOG_WARN("[MASTER] Transfer timed out after %d of %d bytes\n", done, len);
+    }
+    return done;
+}
+
+void link_master_end() {
+    if (!active) return;
+    timerDetachInterrupt(timer);
+    timerEnd(timer);
+    timer = nullptr;
+    active = false;
+    pinsRelease(perByte);
+}
+
+int link_master_bench(int bytes) {
+    static uint8_t tx[LINK_MASTER_BENCH_BYTES];
+    static uint8_t rx[LINK_MASTER_BENCH_BYTES];
+    if (bytes > LINK_MASTER_BENCH_BYTES) bytes = LINK_MASTER_BENCH_BYTES;
+
+    int passed = 0;
+    for (int r = 0; r < LINK_CLOCK_RATES; r++) {
+        for (int i = 0; i < bytes; i++) tx[i] = (uint8_t)(i * 73 + r);
+        if (!link_master_begin((LinkClockRate)r, LINK_MASTER_GAP_US)) {
+            LOG_WARN("[MASTER] Not available on this link backend\n");
+            return 0;
+        }
+#if LINK_BACKEND == LINK_BACKEND_SIM
+        simExpect = tx;
+#endif
+        uint32_t byteUs = 8000000UL / LINK_CLOCK_HZ[r] + LINK_MASTER_GAP_US;
+        int done = link_master_transfer(tx, rx, bytes, bytes * byteUs * 2 / 1000 + 100);
+        link_master_end();
+
+        LinkMasterStats* s = &stats[r];
+#if LINK_BACKEND == LINK_BACKEND_SIM
+        simExpect = nullptr;
+        s->dataErrors = simErrors;
+        for (int i = 0; i < done; i++) {
+            if (rx[i] != simPattern(i)) s->dataErrors++;
+        }
+#endif
+        if (done == bytes && s->lateBits == 0 && s->dataErrors == 0) passed++;
+
+        LOG_INFO("[MASTER] %u Hz%s: %d/%d bytes in %uus (%u B/s), bit %u/%u/%u ns "
+                 "(min/avg/max), %u late, %u data errors\n",
+                 (unsigned)s->hz, s->perByte ? " (per byte)" : "", done, bytes,
+                 (unsigned)s->elapsedUs, (unsigned)s->bytesPerSec,
+                 (unsigned)s->bitMinNs, (unsigned)s->bitAvgNs, (unsigned)s->bitMaxNs,
+                 (unsigned)s->lateBits, (unsigned)s->dataErrors);
+    }
+    return passed;
+}
+
+void link_master_getStats(LinkClockRate r, LinkMasterStats* out) {
+    *out = stats[r];
+}
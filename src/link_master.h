@@ -0,0 +1,62 @@
+#ifndef LINK_MASTER_H
+#define LINK_MASTER_H
+
+#include "config.h"
+
+// =============================================================================
+// Link Master — we drive SCLK
+// =============================================================================
+// The link_* API is always the clock slave. Master mode borrows the cable for
+// a while to clock bytes out ourselves: toward a printer, or toward a game
+// that is waiting as the slave. A hardware timer interrupt makes the clock
+// edges at 8/16 kHz; at the fast clocks GPSPI2 shifts the bits and the timer
+// paces whole bytes. Either way the rate doesn't depend on the loop.
+//
+// Only the GPIO backend (real pins) and the simulator (a virtual slave that
+// checks every edge and byte) support it; begin() fails on the others.
+
+enum LinkClockRate {
+    LINK_CLOCK_8K,                      // DMG / CGB normal speed, 8192 Hz
+    LINK_CLOCK_16K,                     // CGB double speed, 16384 Hz
+    LINK_CLOCK_256K,                    // CGB fast clock, 262144 Hz
+    LINK_CLOCK_512K,                    // CGB fast clock in double speed, 524288 Hz
+    LINK_CLOCK_RATES
+};
+
+// Per rate, since the last begin() at that rate
+struct LinkMasterStats {
+    uint32_t hz;                        // Nominal clock
+    uint32_t clockHz;                   // Clock actually generated (GPSPI2 divider)
+    bool perByte;                       // GPSPI2 shifts, one timer interrupt per byte
+    uint32_t bytes;
+    uint32_t elapsedUs;                 // Start of the first byte to the end of the last
+    uint32_t bytesPerSec;
+    uint32_t bitAvgNs;                  // Rising edge to rising edge within a byte
+    uint32_t bitMinNs;
+    uint32_t bitMaxNs;
+    uint32_t lateBits;                  // Bit periods more than 25% off nominal; per
+                                        // byte: slots the peripheral hadn't finished
+    uint32_t dataErrors;                // Simulator: bytes that arrived wrong on either side
+};
+
+extern const uint32_t LINK_CLOCK_HZ[LINK_CLOCK_RATES];
+
+// Take SCLK from the slave transport and idle it high. gapUs is the pause
+// after each byte, which a slave game needs to reload its serial register.
+// Call only from the loop task while no session is running.
+bool link_master_begin(LinkClockRate rate, uint32_t gapUs);
+
+// Clock len bytes; rx may be null. Blocks until done or timeout_ms passes.
+// Returns the bytes exchanged.
+int link_master_transfer(const uint8_t* tx, uint8_t* rx, int len, uint32_t timeout_ms);
+
+// Stop the timer and hand SCLK back to the slave transport
+void link_master_end();
+
+// Clock `bytes` bytes at every rate and record the stats. Returns the rates
+// that ran with no late bits and no data errors.
+int link_master_bench(int bytes);
+
+void link_master_getStats(LinkClockRate rate, LinkMasterStats* out);
+
+#endif // LINK_MASTER_H
@@ -0,0 +1,262 @@
+#include "config.h"
+#include "link_transport.h"
+#include "capture.h"
+#include "link_timing.h"
+#include "debug_log.h"
+#include <LittleFS.h>
+#include <string.h>
+
+// =============================================================================
+// Replay Transport — recorded sessions as the virtual Game Boy
+// =============================================================================
+// Walks /capture in id order and plays each session's received bytes back at
+// full speed. Every response we stage is compared with the one recorded for
+// the same exchange; the Game Boy's bytes are fixed, so the first difference
+// is where the engine's behaviour changed. loop() runs each session with the
+// party and settings from its capture header (see replay_header()).
+//
+// Timing is not reproduced, but the recorded byte periods feed the clock
+// estimate, and each session reports its time on the wire and its longest
+// pause: the numbers a shorter session timeout would have to be checked
+// against. Web decisions during a manual confirmation are not recorded: such sessions replay with the header's auto-confirm
+// setting and may differ from the confirmation step on.
+
+enum ReplayPhase {
+    REPLAY_OPEN,        // Find and open the next capture
+    REPLAY_START,       // Opened; give loop() one idle pass to adopt it
+    REPLAY_RUN,
+    REPLAY_DISCONNECT,  // Silent until loop() has reset the connection
+    REPLAY_STOPPED
+};
+
+#define REPLAY_CHUNK 512
+
+static ReplayPhase phase = REPLAY_OPEN;
+static File file;
+static CaptureHeader header;
+static uint32_t sessionId = 0;
+static int lastCaptureId = -1;
+static bool idleSeen = false;
+static uint32_t sinceYield = 0;
+
+static uint8_t chunk[REPLAY_CHUNK];
+static size_t chunkLen = 0;
+static size_t chunkPos = 0;
+
+static uint8_t nextTx = 0x00;
+static bool expectPending = false;      // A recorded response awaits setResponse()
+static uint8_t expectResp = 0x00;
+
+static uint32_t sessionBytes = 0;
+static uint32_t sessionMismatches = 0;
+static uint32_t sessionLost = 0;
+static uint32_t sessionUs = 0;          // Recorded time from first to last byte
+static uint32_t sinceByteUs = 0;
+static uint32_t sessionPeakUs = 0;      // Longest recorded pause
+static uint32_t totalSessions = 0;
+static uint32_t totalMismatches = 0;
+static uint32_t totalPeakUs = 0;
+
+static int readByte() {
+    if (chunkPos == chunkLen) {
+        chunkLen = file.read(chunk, sizeof(chunk));
+        chunkPos = 0;
+        if (chunkLen == 0) return -1;
+    }
+    return chunk[chunkPos++];
+}
+
+static bool readVarint(uint32_t* out) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int b = readByte();
+        if (b < 0) return false;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void enter(ReplayPhase p) {
+    phase = p;
+    idleSeen = false;
+}
+
+// Smallest capture id above the last one played
+static bool openNext() {
+    CaptureInfo list[CAPTURE_MAX_FILES];
+    int n = capture_list(list, CAPTURE_MAX_FILES);
+    for (int i = 0; i < n; i++) {
+        if (list[i].id <= lastCaptureId) continue;
+        lastCaptureId = list[i].id;
+
+        char path[32];
+        capture_path(list[i].id, path, sizeof(path));
+        file = LittleFS.open(path, "r");
+        if (!file) continue;
+        if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+            memcmp(header.magic, "PTCP", 4) != 0 || header.format != CAPTURE_FORMAT) {
+            LOG_WARN("[REPLAY] c%04u: not a capture, skipped\n", (unsigned)list[i].id);
+            file.close();
+            continue;
+        }
+        chunkLen = chunkPos = 0;
+        sessionBytes = sessionMismatches = sessionLost = 0;
+        sessionUs = sinceByteUs = sessionPeakUs = 0;
+        sessionId++;
+        return true;
+    }
+    return false;
+}
+
+static void finishSession() {
+    file.close();
+    totalSessions++;
+    totalMismatches += sessionMismatches;
+    if (sessionPeakUs > totalPeakUs) totalPeakUs = sessionPeakUs;
+    LOG_INFO("[REPLAY] c%04u: %u bytes, %u mismatches%s\n",
+             (unsigned)lastCaptureId, (unsigned)sessionBytes, (unsigned)sessionMismatches,
+             sessionLost ? " (capture has gaps)" : "");
+    LOG_INFO("[REPLAY] c%04u: %ums on the wire, longest pause %uus\n",
+             (unsigned)lastCaptureId, (unsigned)(sessionUs / 1000), (unsigned)sessionPeakUs);
+    enter(REPLAY_DISCONNECT);
+}
+
+// =============================================================================
+// Transport ops
+// =============================================================================
+
+static void replayInit() {
+    enter(REPLAY_OPEN);
+}
+
+static int replayPoll(uint8_t* sent, uint32_t* doneUs) {
+    switch (phase) {
+    case REPLAY_STOPPED:
+        return -1;
+
+    case REPLAY_DISCONNECT:
+        if (!idleSeen) return -1;
+        enter(REPLAY_OPEN);
+        // Fall through
+    case REPLAY_OPEN:
+        if (!openNext()) {
+            if (REPLAY_LOOP && totalSessions > 0) {
+                lastCaptureId = -1;
+                if (openNext()) {
+                    enter(REPLAY_START);
+                    return -1;
+                }
+            }
+            LOG_INFO("[REPLAY] Done: %u sessions, %u mismatches, longest pause %uus\n",
+                     (unsigned)totalSessions, (unsigned)totalMismatches, (unsigned)totalPeakUs);
+            enter(REPLAY_STOPPED);
+            return -1;
+        }
+        enter(REPLAY_START);
+        return -1;
+
+    case REPLAY_START:
+        enter(REPLAY_RUN);
+        return -1;
+
+    case REPLAY_RUN:
+        break;
+    }
+
+    if (sinceYield >= SIM_YIELD_BYTES) return -1;
+    sinceYield++;
+
+    // Skip to the next exchange
+    for (;;) {
+        uint32_t v;
+        if (!readVarint(&v)) {
+            finishSession();
+            return -1;
+        }
+        uint8_t type = v & 3;
+        if (type == CAPTURE_REC_LOST) {
+            sessionLost += v >> 2;
+            continue;
+        }
+        sinceByteUs += v >> 2;
+        int a = readByte();
+        int b = readByte();
+        if (type == CAPTURE_REC_BYTE_S && readByte() < 0) b = -1;
+        if (a < 0 || b < 0) {
+            finishSession();
+            return -1;
+        }
+        if (type == CAPTURE_REC_STATE) continue;
+
+        if (sessionBytes > 0) {
+            if (sinceByteUs > sessionPeakUs) sessionPeakUs = sinceByteUs;
+            linkTiming_byte(sinceByteUs);
+            sessionUs += sinceByteUs;
+        }
+        sinceByteUs = 0;
+        sessionBytes++;
+        expectResp = b;
+        expectPending = true;
+        *sent = nextTx;
+        *doneUs = micros();
+        return a;
+    }
+}
+
+static void replayWait(uint32_t wait_ms) {
+    if (sinceYield >= SIM_YIELD_BYTES || phase == REPLAY_STOPPED) {
+        sinceYield = 0;
+        vTaskDelay(1);
+    }
+}
+
+static void replaySetResponse(uint8_t sendByte) {
+    nextTx = sendByte;
+    if (!expectPending) return;
+    expectPending = false;
+    if (sendByte == expectResp) return;
+
+    if (sessionMismatches++ == 0) {
+        LOG_WARN("[REPLAY] c%04u: byte %u answered %02X, recorded %02X\n",
+                 (unsigned)lastCaptureId, (unsigned)sessionBytes, sendByte, expectResp);
+    }
+}
+
+static uint32_t replayIdleUs() {
+    if (phase == REPLAY_RUN) return 0;
+    if (phase == REPLAY_DISCONNECT || phase == REPLAY_STOPPED) idleSeen = true;
+    return 0xFFFFFFFF;
+}
+
+static uint32_t replayOverruns() {
+    // Mismatched responses stand in for overruns, like the simulator's errors
+    return totalMismatches + sessionMismatches;
+}
+
+// =============================================================================
+// Replay context for loop()
+// =============================================================================
+
+uint32_t replay_sessionId() {
+    return sessionId;
+}
+
+const CaptureHeader* replay_header() {
+    return &header;
+}
+
+const LinkTransport linkTransportReplay = {
+    "replay",
+    replayInit,
+    replayPoll,
+    replayWait,
+    nullptr,            // Never blocks for long
+    replaySetResponse,
+    replayIdleUs,
+    replayOverruns,
+    nullptr             // Recorded bytes are already framed
+};
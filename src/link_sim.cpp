@@ -0,0 +1,490 @@
+#include "config.h"
+#include "link_transport.h"
+#include "trade_data.h"
+#include "framing.h"
+#include <string.h>
+
+// =============================================================================
+// Simulated Transport — virtual Game Boy master
+// =============================================================================
+// Plays the Game Boy side of a Gen 1 / Gen 2 trade at full speed: handshake,
+// Trade Centre select, random block, party block, patch list, selection and
+// confirmation. Sessions alternate between generations; each runs
+// SIM_TRADES_PER_SESSION trades and then goes quiet long enough for loop()
+// to see an idle link and reset, which makes it a connect/disconnect soak.
+// With SIM_PRINT_EVERY set, every Nth session is a Game Boy Camera style
+// print instead: INIT, 9 DATA bands (alternately RLE-compressed), an empty
+// DATA, PRINT, then INQUIRY until the printer is no longer busy.
+//
+// Every exchange is driven by our staged response, exactly like a real cable:
+// the byte we answer to GB byte N arrives with GB byte N+1, so the earliest
+// the virtual GB can react to it is with byte N+2.
+//
+// With SIM_FAULT_EVERY set, the cable also loses or gains a clock edge now
+// and then. From there our byte boundary sits off the GB's, and both sides
+// see the other's bytes straddled across two, until link_realign() moves it
+// back or the idle gap at session end resets it (as the ISR's partial-byte
+// timeout does on hardware).
+
+enum SimPhase {
+    SIM_MASTER,         // 0x01 until we answer 0x02
+    SIM_CONNECT,        // 0x60/0x61 until echoed
+    SIM_MENU,           // Highlight a few items, then D4
+    SIM_TC_SYNC,        // 0x00 into TC_INIT
+    SIM_PREAMBLE,       // 0xFD run before the random block
+    SIM_RANDOM,         // Random block payload
+    SIM_DATA_PREAMBLE,  // 0xFD run before the party block
+    SIM_DATA,           // Party block
+    SIM_PATCH_PREAMBLE, // 0xFD run before the patch list
+    SIM_PATCH,          // Patch list
+    SIM_SELECT,         // 0x60 + selection, then 0x00
+    SIM_CONFIRM,        // 0x62
+    SIM_CONFIRM_WAIT,   // 0x00 (DONE -> INIT) while our answer is in flight
+    SIM_CONFIRM_RESULT, // Check our answer to 0x62
+    SIM_PRINT,          // One printer packet; the next is chosen from our status
+    SIM_DISCONNECT,     // Silent: idleUs() reports a dead cable
+    SIM_STOPPED         // SIM_SESSIONS reached
+};
+
+static SimPhase phase = SIM_MASTER;
+static uint32_t phaseBytes = 0;     // Bytes sent in the current phase
+static uint8_t nextTx = 0x00;       // Our staged response
+static uint8_t lastRx = 0x00;       // Our response in the latest exchange
+
+static Generation simGen = GEN_1;
+static uint32_t sessionCount = 0;
+static uint32_t tradesThisSession = 0;
+static uint32_t sinceYield = 0;
+static uint32_t errorCount = 0;
+static bool idleSeen = false;       // loop() has observed the disconnect
+static uint32_t rng = 0x1234567;
+
+// Print sessions: the packet on the wire and where the script is
+enum PrintStep {
+    PRINT_INIT,
+    PRINT_DATA,
+    PRINT_DATA_END,
+    PRINT_PRINT,
+    PRINT_INQUIRY
+};
+
+#define SIM_PRINT_BANDS     9           // 144 rows, a Game Boy Camera photo
+#define SIM_PRINT_INQUIRIES 16          // Still busy after this many = error
+
+static bool simPrint = false;
+static PrintStep printStep = PRINT_INIT;
+static int printBand = 0;
+static int printInquiries = 0;
+static bool printSawBusy = false;
+static uint8_t gbPacket[10 + 2 * GBP_DATA_PACKET_SIZE];
+static uint16_t gbPacketLen = 0;
+
+// Fault injection: bits our byte boundary lags the GB's
+static uint8_t slip = 0;
+static uint8_t prevGb = 0;
+static uint8_t prevTx = 0;
+static uint32_t faultCountdown = SIM_FAULT_EVERY;
+static uint32_t slipBytes = 0;
+static uint32_t slipStartUs = 0;
+static uint32_t recoveries = 0;
+static uint64_t recoveryBytesTotal = 0;
+static uint64_t recoveryUsTotal = 0;
+static SimFaultStats faults;
+
+// Virtual Game Boy's own party, patched for the wire
+static uint8_t gbBlock[MAX_PARTY_BLOCK_SIZE];
+static uint8_t gbPatch[GEN1_PATCH_LIST_SIZE];
+static uint16_t gbDataLen = 0;
+
+static uint8_t randomByte() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (uint8_t)rng;
+}
+
+static void enter(SimPhase p) {
+    phase = p;
+    phaseBytes = 0;
+    idleSeen = false;
+}
+
+// Packet framing: 88 33 cmd comp len data checksum, then two 00 for the replies
+static void buildPacket(uint8_t cmd, bool compressed, const uint8_t* data, uint16_t len) {
+    uint8_t* p = gbPacket;
+    *p++ = GBP_SYNC_0;
+    *p++ = GBP_SYNC_1;
+    *p++ = cmd;
+    *p++ = compressed ? 1 : 0;
+    *p++ = len & 0xFF;
+    *p++ = len >> 8;
+    if (len > 0) memcpy(p, data, len);
+    p += len;
+    uint16_t sum = 0;
+    for (uint8_t* q = gbPacket + 2; q < p; q++) sum += *q;
+    *p++ = sum & 0xFF;
+    *p++ = sum >> 8;
+    *p++ = 0x00;
+    *p++ = 0x00;
+    gbPacketLen = p - gbPacket;
+}
+
+// Printer RLE: runs of 2-129 equal bytes (0x80 | n-2, byte), else 1-128 literals (n-1, bytes)
+static uint16_t rleEncode(const uint8_t* in, uint16_t len, uint8_t* out) {
+    uint16_t o = 0, i = 0;
+    while (i < len) {
+        uint16_t run = 1;
+        while (i + run < len && run < 129 && in[i + run] == in[i]) run++;
+        if (run >= 2) {
+            out[o++] = 0x80 | (run - 2);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        uint16_t lit = 1;
+        while (i + lit < len && lit < 128 &&
+               !(i + lit + 1 < len && in[i + lit] == in[i + lit + 1])) lit++;
+        out[o++] = lit - 1;
+        memcpy(out + o, in + i, lit);
+        o += lit;
+        i += lit;
+    }
+    return o;
+}
+
+static void buildPrintPacket() {
+    static uint8_t band[GBP_DATA_PACKET_SIZE];
+    static uint8_t packed[2 * GBP_DATA_PACKET_SIZE];
+
+    switch (printStep) {
+    case PRINT_INIT:
+        buildPacket(GBP_CMD_INIT, false, nullptr, 0);
+        break;
+    case PRINT_DATA:
+        // Stripes with some noise: long runs plus literal stretches
+        for (int i = 0; i < GBP_DATA_PACKET_SIZE; i++) {
+            band[i] = (i & 63) < 8 ? randomByte() : (((i >> 5) + printBand) & 1) ? 0xFF : 0x00;
+        }
+        if (printBand & 1) {
+            buildPacket(GBP_CMD_DATA, true, packed, rleEncode(band, sizeof(band), packed));
+        } else {
+            buildPacket(GBP_CMD_DATA, false, band, sizeof(band));
+        }
+        break;
+    case PRINT_DATA_END:
+        buildPacket(GBP_CMD_DATA, false, nullptr, 0);
+        break;
+    case PRINT_PRINT: {
+        static const uint8_t params[4] = { 0x01, 0x13, 0xE4, 0x40 };
+        buildPacket(GBP_CMD_PRINT, false, params, sizeof(params));
+        break;
+    }
+    case PRINT_INQUIRY:
+        buildPacket(GBP_CMD_INQUIRY, false, nullptr, 0);
+        break;
+    }
+}
+
+// Our status for the packet just sent picks the next one; false = session over
+static bool nextPrintStep(uint8_t status) {
+    if (status & GBP_STATUS_CHECKSUM) {
+        errorCount++;
+        return false;
+    }
+    switch (printStep) {
+    case PRINT_INIT:
+        printStep = PRINT_DATA;
+        printBand = 0;
+        break;
+    case PRINT_DATA:
+        if (++printBand == SIM_PRINT_BANDS) printStep = PRINT_DATA_END;
+        break;
+    case PRINT_DATA_END:
+        printStep = PRINT_PRINT;
+        break;
+    case PRINT_PRINT:
+        printStep = PRINT_INQUIRY;
+        printInquiries = 0;
+        printSawBusy = (status & GBP_STATUS_BUSY) != 0;
+        break;
+    case PRINT_INQUIRY:
+        if (status & GBP_STATUS_BUSY) {
+            printSawBusy = true;
+            if (++printInquiries < SIM_PRINT_INQUIRIES) break;
+            errorCount++;
+            return false;
+        }
+        if (!printSawBusy) errorCount++;
+        return false;
+    }
+    buildPrintPacket();
+    return true;
+}
+
+// counter: how we got back in step (null = a second fault cancelled the first)
+static void setSlip(uint8_t s, uint32_t* counter) {
+    if (slip == 0 && s != 0) {
+        slipBytes = 0;
+        slipStartUs = micros();
+    } else if (slip != 0 && s == 0 && counter) {
+        uint32_t us = micros() - slipStartUs;
+        (*counter)++;
+        recoveries++;
+        recoveryBytesTotal += slipBytes;
+        recoveryUsTotal += us;
+        if (slipBytes > faults.recoveryMaxBytes) faults.recoveryMaxBytes = slipBytes;
+        if (us > faults.recoveryMaxUs) faults.recoveryMaxUs = us;
+    }
+    slip = s;
+}
+
+static void injectFault() {
+    if (--faultCountdown > 0) return;
+    faultCountdown = SIM_FAULT_EVERY / 2 + (uint32_t)randomByte() * SIM_FAULT_EVERY / 256;
+    if (faultCountdown == 0) faultCountdown = 1;
+    if (randomByte() & 1) {
+        faults.dropped++;
+        setSlip((slip + 1) & 7, nullptr);   // One bit short: everything after arrives late
+    } else {
+        faults.glitches++;
+        setSlip((slip + 7) & 7, nullptr);   // One bit extra
+    }
+}
+
+static void startSession() {
+    setSlip(0, &faults.byIdle);
+    simGen = (sessionCount & 1) ? GEN_2 : GEN_1;
+    sessionCount++;
+    tradesThisSession = 0;
+
+    simPrint = SIM_PRINT_EVERY > 0 && sessionCount % SIM_PRINT_EVERY == 0;
+    if (simPrint) {
+        printStep = PRINT_INIT;
+        buildPrintPacket();
+        enter(SIM_PRINT);
+        return;
+    }
+
+    if (simGen == GEN_1) {
+        gen1_buildDefaultParty((Gen1PartyBlock*)gbBlock);
+        gbDataLen = GEN1_PARTY_BLOCK_SIZE - GEN1_PREAMBLE_SIZE;
+    } else {
+        gen2_buildDefaultParty((Gen2PartyBlock*)gbBlock);
+        gbDataLen = GEN2_PARTY_BLOCK_SIZE - GEN2_PREAMBLE_SIZE;
+    }
+    buildPatchList(gbBlock + GEN1_PREAMBLE_SIZE, gbDataLen, gbPatch, PATCH_DATA_SPLIT);
+    enter(SIM_MASTER);
+}
+
+// Produce the next Game Boy byte given our answer to the previous one
+static uint8_t nextGbByte(uint8_t answer) {
+    switch (phase) {
+    case SIM_MASTER:
+        if (answer == PKMN_SLAVE) { enter(SIM_CONNECT); return nextGbByte(answer); }
+        return PKMN_MASTER;
+
+    case SIM_CONNECT: {
+        uint8_t conn = (simGen == GEN_1) ? PKMN_CONNECTED : PKMN_CONNECTED_GEN2;
+        if (phaseBytes > 0 && answer == conn) { enter(SIM_MENU); return nextGbByte(answer); }
+        return conn;
+    }
+
+    case SIM_MENU: {
+        static const uint8_t menu[] = { ITEM_1_HIGHLIGHTED, ITEM_2_HIGHLIGHTED,
+                                        ITEM_1_HIGHLIGHTED, TRADE_CENTRE };
+        if (phaseBytes < sizeof(menu)) return menu[phaseBytes];
+        enter(SIM_TC_SYNC);
+        return nextGbByte(answer);
+    }
+
+    case SIM_TC_SYNC:
+        if (phaseBytes < 3) return 0x00;
+        enter(SIM_PREAMBLE);
+        return nextGbByte(answer);
+
+    case SIM_PREAMBLE:
+        if (phaseBytes < 8) return SERIAL_PREAMBLE_BYTE;
+        enter(SIM_RANDOM);
+        return nextGbByte(answer);
+
+    case SIM_RANDOM:
+        if (phaseBytes < GEN1_RANDOM_BLOCK_SIZE - 7) {
+            uint8_t r = randomByte();
+            return (r == SERIAL_PREAMBLE_BYTE) ? 0x00 : r;
+        }
+        enter(SIM_DATA_PREAMBLE);
+        return nextGbByte(answer);
+
+    case SIM_DATA_PREAMBLE:
+        if (phaseBytes < GEN1_PREAMBLE_SIZE) return SERIAL_PREAMBLE_BYTE;
+        enter(SIM_DATA);
+        return nextGbByte(answer);
+
+    case SIM_DATA:
+        if (phaseBytes < gbDataLen) return gbBlock[GEN1_PREAMBLE_SIZE + phaseBytes];
+        enter(SIM_PATCH_PREAMBLE);
+        return nextGbByte(answer);
+
+    case SIM_PATCH_PREAMBLE:
+        if (phaseBytes < 3) return SERIAL_PREAMBLE_BYTE;
+        enter(SIM_PATCH);
+        return nextGbByte(answer);
+
+    case SIM_PATCH:
+        if (phaseBytes < GEN1_PATCH_LIST_SIZE - 3) return gbPatch[3 + phaseBytes];
+        enter(SIM_SELECT);
+        return nextGbByte(answer);
+
+    case SIM_SELECT:
+        if (phaseBytes < 3) return TRADE_POKEMON_BASE + (tradesThisSession % PARTY_LENGTH);
+        if (phaseBytes == 3) return 0x00;
+        enter(SIM_CONFIRM);
+        return nextGbByte(answer);
+
+    case SIM_CONFIRM:
+        enter(SIM_CONFIRM_WAIT);
+        return 0x62;
+
+    case SIM_CONFIRM_WAIT:
+        enter(SIM_CONFIRM_RESULT);
+        return 0x00;
+
+    case SIM_CONFIRM_RESULT:
+        // answer is our reply to 0x62; this 0x00 moves INIT -> READY_TO_GO
+        if (answer == 0x00) {
+            // Held for a web decision: ask again, as the game does
+            enter(SIM_CONFIRM_WAIT);
+            return 0x62;
+        }
+        if (answer != 0x62) {
+            errorCount++;
+            enter(SIM_DISCONNECT);
+            return 0x00;
+        }
+        tradesThisSession++;
+        enter(tradesThisSession >= SIM_TRADES_PER_SESSION ? SIM_DISCONNECT : SIM_TC_SYNC);
+        return 0x00;
+
+    case SIM_PRINT:
+        if (phaseBytes < gbPacketLen) {
+            // answer is our reply to the checksum: the device ID
+            if (phaseBytes == gbPacketLen - 1u && answer != GBP_DEVICE_ID) {
+                errorCount++;
+                enter(SIM_DISCONNECT);
+                return 0x00;
+            }
+            return gbPacket[phaseBytes];
+        }
+        // answer is the status for this packet
+        if (!nextPrintStep(answer)) {
+            enter(SIM_DISCONNECT);
+            return 0x00;
+        }
+        enter(SIM_PRINT);
+        return nextGbByte(answer);
+
+    case SIM_DISCONNECT:
+    case SIM_STOPPED:
+        break;
+    }
+    return 0x00;
+}
+
+// =============================================================================
+// Transport ops
+// =============================================================================
+
+static void simInit() {
+    startSession();
+}
+
+static int simPoll(uint8_t* sent, uint32_t* doneUs) {
+    if (phase == SIM_STOPPED) return -1;
+
+    if (phase == SIM_DISCONNECT) {
+        // Stay silent until loop() has seen the idle link and reset
+        if (!idleSeen) return -1;
+#if SIM_SESSIONS > 0
+        if (sessionCount >= SIM_SESSIONS) {
+            enter(SIM_STOPPED);
+            return -1;
+        }
+#endif
+        startSession();
+    }
+
+    if (sinceYield >= SIM_YIELD_BYTES) return -1;
+    sinceYield++;
+
+    uint8_t gb = nextGbByte(lastRx);
+    if (++phaseBytes > SIM_STALL_BYTES) {
+        errorCount++;
+        enter(SIM_DISCONNECT);
+    }
+
+    if (SIM_FAULT_EVERY > 0) injectFault();
+    uint8_t rx = gb;
+    uint8_t seen = nextTx;
+    if (slip) {
+        rx = (uint8_t)(prevGb << slip | gb >> (8 - slip));
+        seen = (uint8_t)(prevTx << (8 - slip) | nextTx >> slip);
+        slipBytes++;
+    }
+    prevGb = gb;
+    prevTx = nextTx;
+
+    *sent = nextTx;
+    *doneUs = micros();
+    lastRx = seen;
+    return rx;
+}
+
+static void simWait(uint32_t wait_ms) {
+    if (sinceYield >= SIM_YIELD_BYTES || phase == SIM_STOPPED) {
+        sinceYield = 0;
+        vTaskDelay(1);
+    }
+}
+
+static void simSetResponse(uint8_t sendByte) {
+    nextTx = sendByte;
+}
+
+static uint32_t simIdleUs() {
+    if (phase == SIM_DISCONNECT || phase == SIM_STOPPED) {
+        idleSeen = true;
+        return 0xFFFFFFFF;
+    }
+    return 0;
+}
+
+static uint32_t simOverruns() {
+    // Protocol errors stand in for overruns: both mean lost exchanges
+    return errorCount;
+}
+
+static void simRealign(uint8_t bits) {
+    setSlip((slip - bits) & 7, &faults.byRealign);
+}
+
+const LinkTransport linkTransportSim = {
+    "sim",
+    simInit,
+    simPoll,
+    simWait,
+    nullptr,            // Never blocks for long
+    simSetResponse,
+    simIdleUs,
+    simOverruns,
+    simRealign
+};
+
+// =============================================================================
+// Fault injection stats
+// =============================================================================
+
+void sim_getFaultStats(SimFaultStats* out) {
+    *out = faults;
+    out->recoveryAvgBytes = recoveries ? (uint32_t)(recoveryBytesTotal / recoveries) : 0;
+    out->recoveryAvgUs = recoveries ? (uint32_t)(recoveryUsTotal / recoveries) : 0;
+}
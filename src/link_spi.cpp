@@ -0,0 +1,152 @@
+#include "config.h"
+#include "link_transport.h"
+#include "link_timing.h"
+#include "driver/spi_slave.h"
+#include "driver/gpio.h"
+#include "esp_rom_gpio.h"
+
+// =============================================================================
+// SPI Transport — GPSPI2 hardware slave
+// =============================================================================
+// The SPI peripheral shifts bits in and out in hardware (mode 3: SCLK idles
+// high, data changes on falling edges, sampled on rising), so bit timing no
+// longer depends on interrupt latency. The Game Boy has no chip select, and
+// the slave only completes a transaction when CS rises, so we drive CS
+// ourselves on PIN_SPI_CS: a rising-edge interrupt counts eight clocks and
+// deasserts it. That ISR only has to finish before the next byte starts, not
+// within half a bit period like the GPIO backend.
+//
+// MOSI/MISO are named from our side in config.h; on the SPI bus the Game Boy
+// is the master, so its data line (PIN_MISO) is the bus MOSI.
+
+static uint8_t txBuf[4] __attribute__((aligned(4)));
+static uint8_t rxBuf[4] __attribute__((aligned(4)));
+static spi_slave_transaction_t trans;
+
+static volatile bool armed = false;         // A transaction is queued
+static volatile uint32_t lastEdgeUs = 0;
+static volatile uint32_t frameEndUs = 0;     // When the queued byte completed
+static volatile uint32_t overrunCount = 0;
+static volatile uint8_t pendingSlip = 0;    // Set by realign(), taken at the next byte
+static uint8_t bitCount = 0;
+
+static spi_slave_transaction_t* pending = nullptr;  // Result fetched by wait()
+
+static void IRAM_ATTR onClockRise() {
+    uint32_t now = micros();
+    if (bitCount != 0 && (now - lastEdgeUs) > linkTiming.partialUs) {
+        bitCount = 0;
+    }
+    if (bitCount == 0) {
+        linkTiming_firstBit(now - lastEdgeUs);
+        if (pendingSlip) {
+            bitCount = pendingSlip;         // Raise CS pendingSlip clocks early
+            pendingSlip = 0;
+        }
+    } else {
+        linkTiming_bit(now - lastEdgeUs);
+    }
+    lastEdgeUs = now;
+
+    if (++bitCount < 8) return;
+    bitCount = 0;
+
+    if (!armed) {
+        // Master clocked a byte before we staged a response
+        overrunCount++;
+        return;
+    }
+    armed = false;
+    frameEndUs = now;
+    WRITE_GPIO_HIGH(PIN_SPI_CS);  // End of frame -> slave completes transaction
+}
+
+static void arm(uint8_t sendByte) {
+    txBuf[0] = sendByte;
+    trans.length = 8;
+    trans.tx_buffer = txBuf;
+    trans.rx_buffer = rxBuf;
+    if (spi_slave_queue_trans(SPI2_HOST, &trans, 0) == ESP_OK) {
+        armed = true;
+        WRITE_GPIO_LOW(PIN_SPI_CS);
+    }
+}
+
+// =============================================================================
+// Transport ops
+// =============================================================================
+
+static void spiInit() {
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = PIN_MISO;
+    bus.miso_io_num = PIN_MOSI;
+    bus.sclk_io_num = PIN_SCLK;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+
+    spi_slave_interface_config_t slave = {};
+    slave.mode = 3;
+    slave.spics_io_num = PIN_SPI_CS;
+    slave.queue_size = 1;
+
+    spi_slave_initialize(SPI2_HOST, &bus, &slave, SPI_DMA_DISABLED);
+
+    // CS is routed into the peripheral as an input; also drive it from GPIO_OUT
+    gpio_set_direction((gpio_num_t)PIN_SPI_CS, GPIO_MODE_INPUT_OUTPUT);
+    esp_rom_gpio_connect_out_signal(PIN_SPI_CS, SIG_GPIO_OUT_IDX, false, false);
+    WRITE_GPIO_HIGH(PIN_SPI_CS);
+
+    lastEdgeUs = micros();
+    attachInterrupt(digitalPinToInterrupt(PIN_SCLK), onClockRise, RISING);
+    arm(0x00);
+}
+
+static int spiPoll(uint8_t* sent, uint32_t* doneUs) {
+    spi_slave_transaction_t* done = pending;
+    pending = nullptr;
+    if (!done && spi_slave_get_trans_result(SPI2_HOST, &done, 0) != ESP_OK) {
+        return -1;
+    }
+    *sent = ((const uint8_t*)done->tx_buffer)[0];
+    *doneUs = frameEndUs;
+    return ((uint8_t*)done->rx_buffer)[0];
+}
+
+static void spiWait(uint32_t wait_ms) {
+    if (pending) return;
+    if (spi_slave_get_trans_result(SPI2_HOST, &pending, pdMS_TO_TICKS(wait_ms)) != ESP_OK) {
+        pending = nullptr;
+    }
+}
+
+static void spiSetResponse(uint8_t sendByte) {
+    // A queued transaction can't be rewritten; the first response staged
+    // after each byte wins.
+    if (!armed) arm(sendByte);
+}
+
+static uint32_t spiIdleUs() {
+    return micros() - lastEdgeUs;
+}
+
+static uint32_t spiOverruns() {
+    return overrunCount;
+}
+
+// The byte that takes the slip gets CS after only 8 - bits clocks, so the
+// slave returns just those bits: that one byte received is garbage.
+static void spiRealign(uint8_t bits) {
+    pendingSlip = bits & 7;
+}
+
+const LinkTransport linkTransportSpi = {
+    "spi",
+    spiInit,
+    spiPoll,
+    spiWait,
+    nullptr,            // Blocked in the driver queue; wait() times out instead
+    spiSetResponse,
+    spiIdleUs,
+    spiOverruns,
+    spiRealign
+};
@@ -0,0 +1,72 @@
+#ifndef LINK_TIMING_H
+#define LINK_TIMING_H
+
+#include <stdint.h>
+
+// =============================================================================
+// Link Timing — running estimate of the master's clock
+// =============================================================================
+// Transports that see clock edges feed bit periods and the pauses between
+// bytes in here straight from their ISRs; byte-level sources (replay) feed
+// whole byte periods. link_cable.cpp turns the estimate into timeouts.
+// Header-only and Arduino-free, like link_transport.h, so ISRs inline it.
+
+#define LINK_EWMA_SHIFT 3                   // Each sample moves an estimate 1/8 of the way
+
+struct LinkTimingState {
+    volatile uint32_t bitUsX16;             // Bit period, 1/16 us (0 = not measured)
+    volatile uint32_t gapUsX16;             // Pause between bytes, 1/16 us
+    volatile uint32_t peakGapUs;            // Longest pause seen
+    volatile uint32_t minByteUs;            // Shortest byte period (byte-level sources)
+    volatile uint32_t gaps;                 // Pause samples taken
+
+    // Set by link_cable.cpp, read by the ISRs
+    volatile uint32_t partialUs;            // A partial byte older than this is stale
+    volatile uint32_t gapLimitUs;           // Longer pauses ended a session: not sampled
+    volatile bool resetPending;             // Clear peakGapUs and gaps at the next pause
+};
+
+extern LinkTimingState linkTiming;
+
+static inline void linkTiming_ewma(volatile uint32_t* est, uint32_t us) {
+    if (us > 0x0FFFFFFF) us = 0x0FFFFFFF;
+    uint32_t x16 = us << 4;
+    uint32_t e = *est;
+    *est = e ? e + ((int32_t)(x16 - e) >> LINK_EWMA_SHIFT) : x16;
+}
+
+// Rising edge inside a byte: us since the previous rising edge
+static inline void linkTiming_bit(uint32_t us) {
+    linkTiming_ewma(&linkTiming.bitUsX16, us);
+}
+
+// The loop task never writes peakGapUs or gaps itself: it sets resetPending
+// and the next pause (in the ISR) clears them, so no update is lost
+static inline void linkTiming_pause(uint32_t us) {
+    if (linkTiming.resetPending) {
+        linkTiming.peakGapUs = 0;
+        linkTiming.gaps = 0;
+        linkTiming.resetPending = false;
+    }
+    if (us >= linkTiming.gapLimitUs) return;
+    if (us > linkTiming.peakGapUs) linkTiming.peakGapUs = us;
+    linkTiming_ewma(&linkTiming.gapUsX16, us);
+    linkTiming.gaps++;
+}
+
+// First rising edge of a byte: us since the last rising edge of the byte
+// before, which is one bit period plus the pause
+static inline void linkTiming_firstBit(uint32_t us) {
+    uint32_t bit = linkTiming.bitUsX16 >> 4;
+    linkTiming_pause(us > bit ? us - bit : 0);
+}
+
+// Byte-level sources: us between the completion of two bytes. Without bit
+// edges, an eighth of the shortest byte period stands in for the bit period.
+static inline void linkTiming_byte(uint32_t us) {
+    if (us < linkTiming.minByteUs) linkTiming.minByteUs = us;
+    uint32_t bit = linkTiming.bitUsX16 ? linkTiming.bitUsX16 >> 4 : linkTiming.minByteUs / 8;
+    linkTiming_pause(us > 8 * bit ? us - 8 * bit : 0);
+}
+
+#endif // LINK_TIMING_H
@@ -0,0 +1,50 @@
+#ifndef LINK_TRANSPORT_H
+#define LINK_TRANSPORT_H
+
+#include <stdint.h>
+
+// =============================================================================
+// Link Transport — backend interface under the link_* API
+// =============================================================================
+// A transport moves bytes between us (clock slave) and the clock master.
+// Every exchange is full duplex: while the master shifts a byte in, we shift
+// out the byte last staged with setResponse().
+
+struct LinkTransport {
+    const char* name;
+
+    // Set up pins/peripherals/file descriptors
+    void (*init)();
+
+    // Non-blocking: pop one completed exchange. Returns the received byte,
+    // stores the byte we sent in *sent and the micros() timestamp at which the
+    // exchange completed in *doneUs, or returns -1 if none is pending.
+    int (*poll)(uint8_t* sent, uint32_t* doneUs);
+
+    // Sleep until a byte may be pending or wait_ms elapses
+    void (*wait)(uint32_t wait_ms);
+
+    // Cut a wait() short from another task (null if the backend can't)
+    void (*wake)();
+
+    // Stage the byte to send on the next exchange
+    void (*setResponse)(uint8_t sendByte);
+
+    // Microseconds since the last clock activity
+    uint32_t (*idleUs)();
+
+    // Completed bytes dropped because the consumer fell behind
+    uint32_t (*overruns)();
+
+    // Bytes are arriving `bits` late: make the next byte complete that many
+    // bits early (null if the backend can't move its byte boundary)
+    void (*realign)(uint8_t bits);
+};
+
+// Backends (each lives in its own link_*.cpp)
+extern const LinkTransport linkTransportGpio;   // SCLK edge-interrupt bit-bang
+extern const LinkTransport linkTransportSpi;    // GPSPI2 hardware SPI slave
+extern const LinkTransport linkTransportSim;    // In-process virtual Game Boy
+extern const LinkTransport linkTransportReplay; // Recorded sessions from /capture
+
+#endif // LINK_TRANSPORT_H
@@ -1,10 +1,20 @@
 #include <Arduino.h>
 #include "config.h"
 #include "link_cable.h"
+#include "link_master.h"
+#include "framing.h"
 #include "led.h"
 #include "trade_data.h"
+#include "gen_traits.h"
 #include "storage.h"
+#include "box_store.h"
+#include "journal.h"
+#include "capture.h"
+#include "printer.h"
+#include "gallery.h"
 #include "wifi_server.h"
+#include "debug_log.h"
+#include "perf.h"
 #include <string.h>
 
 // =============================================================================
@@ -49,6 +59,7 @@ static const char* connStateName(ConnectionState s) {
 // Global State
 // =============================================================================
 
+static AppState appState = STATE_IDLE;
 static ConnectionState connState = CONN_NOT_CONNECTED;
 static TradeCentreState tcState = TC_INIT;
 static Generation gen = GEN_UNKNOWN;
@@ -56,210 +67,340 @@ static Generation gen = GEN_UNKNOWN;
 // Shared context for web server
 static TradeContext ctx;
 
-// Data exchange buffers (sized for Gen 2 which is larger)
-static uint8_t sendBlock[MAX_PARTY_BLOCK_SIZE];
+// Receive buffers (sized for Gen 2 which is larger)
 static uint8_t recvBlock[MAX_PARTY_BLOCK_SIZE];
-static uint8_t sendPatch[GEN1_PATCH_LIST_SIZE];
-static uint8_t recvPatch[GEN1_PATCH_LIST_SIZE];
+static PatchDecoder recvDecoder;            // Restores recvBlock 0xFE bytes as patches arrive
+
+// Outgoing party block + patch list, prepared ahead of the exchange
+struct PreparedParty {
+    uint32_t version;                       // partyVersion() when built
+    bool valid;
+    int partyToStorage[PARTY_LENGTH];       // Party position -> storage slot
+    uint8_t block[MAX_PARTY_BLOCK_SIZE];    // Patched, including preamble
+    uint8_t patch[GEN1_PATCH_LIST_SIZE];
+};
+
+static PreparedParty prepared[2][2];        // [Gen1/Gen2][TradeMode]
+static const PreparedParty* activeParty = &prepared[0][0];
+
+// Journaled at TC_DONE; the idle save fills in where the Pokemon went
+static JournalRecord completedTrade;
+static uint32_t completedSeq = 0;       // Journal seq of the last trade, 0 = none to update
+static uint32_t sessionStartMs = 0;
 
 // Exchange counter for SENDING_DATA and SENDING_PATCH_DATA
 static int counter = 0;
 
-// Data length for current generation (excludes 6-byte preamble)
-static int dataLength = 0;
-
 // Trade tracking
 static int tradePokemon = -1;
 
-// Storage mode: maps party position -> storage slot index
-static int partyToStorage[PARTY_LENGTH];
+// A bit slip was caught after the party block began: recvBlock is suspect
+static bool recvSuspect = false;
 
-// The current byte to send (set by handleByte, consumed by loop)
-static uint8_t outByte = 0x00;
+// Storage mode: maps party position -> storage slot index (copied from the
+// prepared party when the exchange starts)
+static int partyToStorage[PARTY_LENGTH];
 
 // =============================================================================
-// Sync State to TradeContext (for web server visibility)
+// Publish State to TradeContext (for web server visibility)
+// Called after every byte; only publishes when something actually changed.
 // =============================================================================
 
+static TradeStatus status;                  // Loop-owned copy of what was last published
+static bool statusChanged = false;          // Fields in status edited since publish
+
 static void syncContext() {
-    ctx.connState = (int)connState;
-    ctx.tcState = (int)tcState;
-    ctx.gen = (int)gen;
-    ctx.tradePokemon = tradePokemon;
+    if (!statusChanged && status.appState == (int)appState &&
+        status.connState == (int)connState && status.tcState == (int)tcState &&
+        status.gen == (int)gen && status.tradePokemon == tradePokemon) {
+        return;
+    }
+    status.appState = (int)appState;
+    status.connState = (int)connState;
+    status.tcState = (int)tcState;
+    status.gen = (int)gen;
+    status.tradePokemon = tradePokemon;
+    statusChanged = false;
+    tradeStatus_publish(&ctx, &status);
 }
 
 // =============================================================================
-// Prepare Trade Data — Mode-aware party building
+// Web Commands — drained from the ring between bytes, applied in order
 // =============================================================================
 
-static void prepareTradeData() {
-    StoredPokemon* party = storage_getParty(gen);
-    TradeMode mode = (TradeMode)ctx.tradeMode;
-
-    if (gen == GEN_1) {
-        dataLength = GEN1_PARTY_BLOCK_SIZE - GEN1_PREAMBLE_SIZE; // 418
-
-        Gen1PartyBlock* block = (Gen1PartyBlock*)sendBlock;
-        memset(block, 0, sizeof(Gen1PartyBlock));
-        memset(block->preamble, SERIAL_PREAMBLE_BYTE, GEN1_PREAMBLE_SIZE);
-
-        if (mode == TRADE_MODE_CLONE) {
-            if (party[0].occupied) {
-                memcpy(block->playerName, party[0].ot, NAME_LENGTH);
-                block->partyCount = PARTY_LENGTH;
-                for (int i = 0; i < PARTY_LENGTH; i++) {
-                    block->partySpecies[i] = party[0].speciesIndex;
-                    memcpy(&block->pokemon[i], party[0].monData, GEN1_PARTY_STRUCT_SIZE);
-                    memcpy(block->otNames[i], party[0].ot, NAME_LENGTH);
-                    memcpy(block->nicknames[i], party[0].nickname, NAME_LENGTH);
-                    partyToStorage[i] = 0;
-                }
-                block->partySpecies[PARTY_LENGTH] = 0xFF;
-            } else {
-                gen1_buildDefaultParty(block);
-                for (int i = 0; i < PARTY_LENGTH; i++) partyToStorage[i] = -1;
-            }
-        } else {
-            int pos = 0;
-            for (int i = 0; i < PARTY_LENGTH && pos < PARTY_LENGTH; i++) {
-                if (party[i].occupied) {
-                    block->partySpecies[pos] = party[i].speciesIndex;
-                    memcpy(&block->pokemon[pos], party[i].monData, GEN1_PARTY_STRUCT_SIZE);
-                    memcpy(block->otNames[pos], party[i].ot, NAME_LENGTH);
-                    memcpy(block->nicknames[pos], party[i].nickname, NAME_LENGTH);
-                    partyToStorage[pos] = i;
-                    pos++;
-                }
-            }
-            if (pos == 0) {
-                gen1_buildDefaultParty(block);
-                for (int i = 0; i < PARTY_LENGTH; i++) partyToStorage[i] = -1;
+// Web-controlled settings; only the loop writes them
+static TradeMode tradeMode = TRADE_MODE_CLONE;
+static int offerSlot = 0;
+static bool autoConfirm = true;
+static uint32_t holdTimeoutMs = TRADE_HOLD_MS;
+static bool holdDefaultConfirm = false;
+
+// Latest confirm/decline, held until the next trade confirmation uses it
+static TradeCommand decision;
+static bool decisionPending = false;
+
+// Manual confirmation hold: the Game Boy keeps re-sending its choice while we
+// answer with a non-0x6X byte, so the link waits on the web instead of declining
+static bool holding = false;
+static uint32_t holdStartMs = 0;
+
+static void drainCommands() {
+    TradeCommand cmd;
+    while (ctx.commands.pop(&cmd)) {
+        switch (cmd.type) {
+        case CMD_SET_OFFER:
+            if (cmd.arg >= 0 && cmd.arg < PARTY_LENGTH) offerSlot = cmd.arg;
+            break;
+        case CMD_SET_AUTO:
+            autoConfirm = cmd.arg != 0;
+            break;
+        case CMD_SET_MODE:
+            tradeMode = (cmd.arg == TRADE_MODE_STORAGE) ? TRADE_MODE_STORAGE : TRADE_MODE_CLONE;
+            storage_setTradeMode(tradeMode);
+            break;
+        case CMD_SET_HOLD:
+            holdTimeoutMs = (cmd.arg < 0) ? 0 : (cmd.arg > TRADE_HOLD_MAX_MS) ? TRADE_HOLD_MAX_MS : cmd.arg;
+            break;
+        case CMD_SET_HOLD_DEFAULT:
+            holdDefaultConfirm = cmd.arg != 0;
+            break;
+        case CMD_SET_CAPTURE:
+            capture_setEnabled(cmd.arg != 0);
+            break;
+        case CMD_MASTER_BENCH:
+            // Master mode drives SCLK: never while a Game Boy is clocking it. The
+            // virtual Game Boy only moves when polled.
+            if (LINK_BACKEND == LINK_BACKEND_SIM ||
+                (connState == CONN_NOT_CONNECTED && appState == STATE_IDLE &&
+                 link_isIdle(IDLE_TIMEOUT_MS))) {
+                link_master_bench(LINK_MASTER_BENCH_BYTES);
             } else {
-                memcpy(block->playerName, party[partyToStorage[0]].ot, NAME_LENGTH);
-                block->partyCount = pos;
-                block->partySpecies[pos] = 0xFF;
-                for (int i = pos; i < PARTY_LENGTH; i++) partyToStorage[i] = -1;
+                LOG_WARN("[MASTER] Link busy, benchmark skipped\n");
             }
+            break;
+        case CMD_PERF_RESET:
+            perf_reset();
+            break;
+        case CMD_CONFIRM:
+        case CMD_DECLINE:
+            decision = cmd;             // A newer decision replaces an unused one
+            decisionPending = true;
+            break;
+        }
+        if (cmd.type != CMD_CONFIRM && cmd.type != CMD_DECLINE && cmd.type != CMD_PERF_RESET) {
+            perf_commandApplied(micros() - cmd.issuedUs);
         }
 
-        buildPatchList(sendBlock + GEN1_PREAMBLE_SIZE, dataLength,
-                       sendPatch, PATCH_DATA_SPLIT);
-
-    } else { // GEN_2
-        dataLength = GEN2_PARTY_BLOCK_SIZE - GEN2_PREAMBLE_SIZE; // 444
-
-        Gen2PartyBlock* block = (Gen2PartyBlock*)sendBlock;
-        memset(block, 0, sizeof(Gen2PartyBlock));
-        memset(block->preamble, SERIAL_PREAMBLE_BYTE, GEN2_PREAMBLE_SIZE);
-        block->playerId[0] = 0x00;
-        block->playerId[1] = 0x01;
-
-        if (mode == TRADE_MODE_CLONE) {
-            if (party[0].occupied) {
-                memcpy(block->playerName, party[0].ot, NAME_LENGTH);
-                block->partyCount = PARTY_LENGTH;
-                for (int i = 0; i < PARTY_LENGTH; i++) {
-                    block->partySpecies[i] = party[0].speciesIndex;
-                    memcpy(&block->pokemon[i], party[0].monData, GEN2_PARTY_STRUCT_SIZE);
-                    memcpy(block->otNames[i], party[0].ot, NAME_LENGTH);
-                    memcpy(block->nicknames[i], party[0].nickname, NAME_LENGTH);
-                    partyToStorage[i] = 0;
-                }
-                block->partySpecies[PARTY_LENGTH] = 0xFF;
-            } else {
-                gen2_buildDefaultParty(block);
-                for (int i = 0; i < PARTY_LENGTH; i++) partyToStorage[i] = -1;
+        status.tradeMode = tradeMode;
+        status.offerSlot = offerSlot;
+        status.autoConfirm = autoConfirm;
+        status.holdTimeoutMs = holdTimeoutMs;
+        status.holdDefaultConfirm = holdDefaultConfirm;
+        status.capturing = capture_isEnabled();
+        status.lastCommandSeq = cmd.seq;
+        statusChanged = true;
+    }
+    syncContext();
+}
+
+enum Verdict {
+    VERDICT_HOLD,
+    VERDICT_CONFIRM,
+    VERDICT_DECLINE
+};
+
+static void setHolding(bool h) {
+    if (h == holding) return;
+    holding = h;
+    status.holding = h;
+    statusChanged = true;
+}
+
+// Manual confirmation: the web's decision if one is in, otherwise hold the
+// link until the deadline and then take the default outcome
+static Verdict manualVerdict() {
+    if (decisionPending) {
+        decisionPending = false;
+        setHolding(false);
+        perf_commandApplied(micros() - decision.issuedUs);
+        return (decision.type == CMD_CONFIRM) ? VERDICT_CONFIRM : VERDICT_DECLINE;
+    }
+
+    uint32_t now = millis();
+    if (!holding) {
+        holdStartMs = now;
+        setHolding(true);
+        if (holdTimeoutMs > 0) {
+            LOG_DEBUG("[TC] Holding for web decision (%ums, then %s)\n",
+                      (unsigned)holdTimeoutMs, holdDefaultConfirm ? "confirm" : "decline");
+        }
+    }
+    if (now - holdStartMs < holdTimeoutMs) return VERDICT_HOLD;
+
+    setHolding(false);
+    if (holdTimeoutMs > 0) LOG_DEBUG("[TC] Hold deadline passed\n");
+    return holdDefaultConfirm ? VERDICT_CONFIRM : VERDICT_DECLINE;
+}
+
+// =============================================================================
+// Prepare Trade Data — Mode-aware party building
+// Runs from loop(), never from handleByte(): the result is cached per
+// generation and trade mode until storage changes.
+// =============================================================================
+
+#if LINK_BACKEND == LINK_BACKEND_REPLAY
+// Replayed sessions run against the party they were captured with
+static StoredPokemon* partySource(Generation g) {
+    return (StoredPokemon*)replay_header()->party[g == GEN_1 ? 0 : 1];
+}
+static uint32_t partyVersion() { return replay_sessionId(); }
+#else
+static StoredPokemon* partySource(Generation g) { return storage_getParty(g); }
+static uint32_t partyVersion() { return storage_getVersion(); }
+#endif
+
+template <Generation G>
+static void prepareParty(TradeMode mode, PreparedParty* out) {
+    typedef GenTraits<G> T;
+    typename T::Block* block = (typename T::Block*)out->block;
+    StoredPokemon* party = partySource(G);
+    int* slotMap = out->partyToStorage;
+
+    memset(block, 0, sizeof(*block));
+    memset(block->preamble, SERIAL_PREAMBLE_BYTE, T::PREAMBLE_SIZE);
+    T::initBlock(block);
+
+    if (mode == TRADE_MODE_CLONE) {
+        if (party[0].occupied) {
+            memcpy(block->playerName, party[0].ot, T::NAME_SIZE);
+            block->partyCount = PARTY_LENGTH;
+            for (int i = 0; i < PARTY_LENGTH; i++) {
+                block->partySpecies[i] = party[0].speciesIndex;
+                memcpy(&block->pokemon[i], party[0].monData, T::MON_SIZE);
+                memcpy(block->otNames[i], party[0].ot, T::NAME_SIZE);
+                memcpy(block->nicknames[i], party[0].nickname, T::NAME_SIZE);
+                slotMap[i] = 0;
             }
+            block->partySpecies[PARTY_LENGTH] = 0xFF;
         } else {
-            int pos = 0;
-            for (int i = 0; i < PARTY_LENGTH && pos < PARTY_LENGTH; i++) {
-                if (party[i].occupied) {
-                    block->partySpecies[pos] = party[i].speciesIndex;
-                    memcpy(&block->pokemon[pos], party[i].monData, GEN2_PARTY_STRUCT_SIZE);
-                    memcpy(block->otNames[pos], party[i].ot, NAME_LENGTH);
-                    memcpy(block->nicknames[pos], party[i].nickname, NAME_LENGTH);
-                    partyToStorage[pos] = i;
-                    pos++;
-                }
-            }
-            if (pos == 0) {
-                gen2_buildDefaultParty(block);
-                for (int i = 0; i < PARTY_LENGTH; i++) partyToStorage[i] = -1;
-            } else {
-                memcpy(block->playerName, party[partyToStorage[0]].ot, NAME_LENGTH);
-                block->partyCount = pos;
-                block->partySpecies[pos] = 0xFF;
-                for (int i = pos; i < PARTY_LENGTH; i++) partyToStorage[i] = -1;
+            T::buildDefaultParty(block);
+            for (int i = 0; i < PARTY_LENGTH; i++) slotMap[i] = -1;
+        }
+    } else {
+        int pos = 0;
+        for (int i = 0; i < PARTY_LENGTH && pos < PARTY_LENGTH; i++) {
+            if (party[i].occupied) {
+                block->partySpecies[pos] = party[i].speciesIndex;
+                memcpy(&block->pokemon[pos], party[i].monData, T::MON_SIZE);
+                memcpy(block->otNames[pos], party[i].ot, T::NAME_SIZE);
+                memcpy(block->nicknames[pos], party[i].nickname, T::NAME_SIZE);
+                slotMap[pos] = i;
+                pos++;
             }
         }
+        if (pos == 0) {
+            T::buildDefaultParty(block);
+            for (int i = 0; i < PARTY_LENGTH; i++) slotMap[i] = -1;
+        } else {
+            memcpy(block->playerName, party[slotMap[0]].ot, T::NAME_SIZE);
+            block->partyCount = pos;
+            block->partySpecies[pos] = 0xFF;
+            for (int i = pos; i < PARTY_LENGTH; i++) slotMap[i] = -1;
+        }
+    }
+
+    buildPatchList(out->block + T::PREAMBLE_SIZE, T::DATA_LENGTH,
+                   out->patch, PATCH_DATA_SPLIT);
 
-        buildPatchList(sendBlock + GEN2_PREAMBLE_SIZE, dataLength,
-                       sendPatch, PATCH_DATA_SPLIT);
+    LOG_INFO("[TRADE] Prepared %s party (%d data bytes, mode=%s)\n",
+             T::name(), (int)T::DATA_LENGTH,
+             mode == TRADE_MODE_CLONE ? "clone" : "storage");
+}
+
+static void refreshPreparedParties() {
+    // Never rebuild a block while it is on the wire
+    if (connState == CONN_TRADE_CENTRE &&
+        tcState >= TC_WAITING_TO_SEND_DATA && tcState <= TC_SENDING_PATCH_DATA) {
+        return;
+    }
+
+    // Read the version first: a write racing the rebuild leaves us stale
+    uint32_t version = partyVersion();
+    for (int m = 0; m < 2; m++) {
+        PreparedParty* p1 = &prepared[0][m];
+        if (!p1->valid || p1->version != version) {
+            prepareParty<GEN_1>((TradeMode)m, p1);
+            p1->version = version;
+            p1->valid = true;
+        }
+        PreparedParty* p2 = &prepared[1][m];
+        if (!p2->valid || p2->version != version) {
+            prepareParty<GEN_2>((TradeMode)m, p2);
+            p2->version = version;
+            p2->valid = true;
+        }
     }
+}
 
-    debug_logf("[TRADE] Prepared %s party (%d data bytes, mode=%s)\n",
-               gen == GEN_1 ? "Gen1" : "Gen2",
-               dataLength,
-               (TradeMode)ctx.tradeMode == TRADE_MODE_CLONE ? "clone" : "storage");
+// Lock in the prepared party for this exchange — O(1), safe between bytes
+template <Generation G>
+static void selectPreparedParty() {
+    int m = (tradeMode == TRADE_MODE_CLONE) ? 0 : 1;
+    activeParty = &prepared[G == GEN_1 ? 0 : 1][m];
+    memcpy(partyToStorage, activeParty->partyToStorage, sizeof(partyToStorage));
 }
 
 // =============================================================================
 // Save Received Pokemon to NVS
 // =============================================================================
 
+template <Generation G>
 static void saveReceivedPokemon() {
+    typedef GenTraits<G> T;
     if (tradePokemon < 0 || tradePokemon >= PARTY_LENGTH) return;
 
-    applyPatchList(recvBlock, dataLength, recvPatch);
-
     StoredPokemon received;
     memset(&received, 0, sizeof(received));
     received.occupied = true;
 
-    int monSize, monOffset, otOffset, nickOffset;
-
-    if (gen == GEN_1) {
-        monSize = GEN1_PARTY_STRUCT_SIZE;
-        monOffset = 19 + (tradePokemon * monSize);
-        otOffset = 283 + (tradePokemon * NAME_LENGTH);
-        nickOffset = 349 + (tradePokemon * NAME_LENGTH);
-        received.speciesIndex = recvBlock[12 + tradePokemon];
+    const uint8_t* monData = recvBlock + T::MON_OFFSET + tradePokemon * T::MON_SIZE;
+    received.speciesIndex = recvBlock[T::SPECIES_OFFSET + tradePokemon];
+    memcpy(received.monData, monData, T::MON_SIZE);
+    memcpy(received.ot, recvBlock + T::OT_OFFSET + tradePokemon * T::NAME_SIZE, T::NAME_SIZE);
+    memcpy(received.nickname, recvBlock + T::NICK_OFFSET + tradePokemon * T::NAME_SIZE, T::NAME_SIZE);
 
-        memcpy(received.monData, recvBlock + monOffset, monSize);
-        memcpy(received.ot, recvBlock + otOffset, NAME_LENGTH);
-        memcpy(received.nickname, recvBlock + nickOffset, NAME_LENGTH);
+    const typename T::Mon* mon = (const typename T::Mon*)monData;
+    LOG_INFO("[TRADE] Received %s: %s (%s=%d) Lv%d\n",
+             T::name(), T::speciesName(mon->species), T::speciesTag(),
+             mon->species, mon->level);
 
-        Gen1PartyMon* mon = (Gen1PartyMon*)(recvBlock + monOffset);
-        debug_logf("[TRADE] Received Gen1: %s (idx=0x%02X) Lv%d\n",
-                   gen1_getSpeciesName(mon->species), mon->species, mon->level);
-    } else {
-        monSize = GEN2_PARTY_STRUCT_SIZE;
-        monOffset = 21 + (tradePokemon * monSize);
-        otOffset = 309 + (tradePokemon * NAME_LENGTH);
-        nickOffset = 375 + (tradePokemon * NAME_LENGTH);
-        received.speciesIndex = recvBlock[12 + tradePokemon];
-
-        memcpy(received.monData, recvBlock + monOffset, monSize);
-        memcpy(received.ot, recvBlock + otOffset, NAME_LENGTH);
-        memcpy(received.nickname, recvBlock + nickOffset, NAME_LENGTH);
-
-        Gen2PartyMon* mon = (Gen2PartyMon*)(recvBlock + monOffset);
-        debug_logf("[TRADE] Received Gen2: %s (dex=%d) Lv%d\n",
-                   gen2_getSpeciesName(mon->species), mon->species, mon->level);
-    }
+#if LINK_BACKEND == LINK_BACKEND_SIM || LINK_BACKEND == LINK_BACKEND_REPLAY
+    // Benchmark/soak sessions trade thousands of times; keep them off flash
+    tradePokemon = -1;
+    return;
+#endif
 
-    TradeMode mode = (TradeMode)ctx.tradeMode;
+    TradeMode mode = tradeMode;
     int saveSlot;
 
     if (mode == TRADE_MODE_CLONE) {
         saveSlot = 0;
     } else {
-        int offerPos = ctx.offerSlot;
+        int offerPos = offerSlot;
         saveSlot = (offerPos >= 0 && offerPos < PARTY_LENGTH && partyToStorage[offerPos] >= 0)
                    ? partyToStorage[offerPos] : 0;
     }
 
-    storage_saveSlot(gen, saveSlot, &received);
+    storage_saveSlot(G, saveSlot, &received);
+
+    // Keep every received Pokemon, even once its party slot is overwritten
+    int boxId = box_add(G, &received);
+    if (boxId >= 0) LOG_INFO("[BOX] Archived as #%d\n", boxId);
+    else LOG_WARN("[BOX] Box full, not archived\n");
+
+    if (completedSeq) journal_setSaved(completedSeq, saveSlot, boxId);
+    completedSeq = 0;
+
     tradePokemon = -1;
 }
 
@@ -267,39 +408,273 @@ static void saveReceivedPokemon() {
 // Log Received Party Summary + populate TradeContext opponent info
 // =============================================================================
 
+template <Generation G>
 static void logReceivedParty() {
-    int count = recvBlock[11];
+    typedef GenTraits<G> T;
+    int count = recvBlock[T::COUNT_OFFSET];
     if (count > PARTY_LENGTH) count = PARTY_LENGTH;
 
-    ctx.opponentCount = count;
+    status.opponentCount = count;
+    status.opponentVersion++;
+    statusChanged = true;
 
-    debug_logf("[TRADE] Opponent party (%d Pokemon):\n", count);
+    LOG_INFO("[TRADE] Opponent party (%d Pokemon):\n", count);
 
     for (int i = 0; i < count; i++) {
-        if (gen == GEN_1) {
-            int monOff = 19 + i * GEN1_PARTY_STRUCT_SIZE;
-            int nickOff = 349 + i * NAME_LENGTH;
-            Gen1PartyMon* mon = (Gen1PartyMon*)(recvBlock + monOff);
-            ctx.opponentSpecies[i] = mon->species;
-            ctx.opponentLevels[i] = mon->level;
-            memcpy((void*)ctx.opponentNicknames[i], recvBlock + nickOff, NAME_LENGTH);
-            debug_logf("  [%d] %s (idx=0x%02X) Lv%d HP=%d\n",
-                       i, gen1_getSpeciesName(mon->species),
-                       mon->species, mon->level,
-                       (mon->hp[0] << 8) | mon->hp[1]);
+        const typename T::Mon* mon =
+            (const typename T::Mon*)(recvBlock + T::MON_OFFSET + i * T::MON_SIZE);
+        status.opponentSpecies[i] = mon->species;
+        status.opponentLevels[i] = mon->level;
+        memcpy(status.opponentNicknames[i], recvBlock + T::NICK_OFFSET + i * T::NAME_SIZE,
+               T::NAME_SIZE);
+        LOG_INFO("  [%d] %s (%s=%d) Lv%d HP=%d\n",
+                 i, T::speciesName(mon->species), T::speciesTag(),
+                 mon->species, mon->level,
+                 (mon->hp[0] << 8) | mon->hp[1]);
+    }
+}
+
+// =============================================================================
+// Trade Centre — the main trade protocol state machine, one instance per
+// generation
+// =============================================================================
+
+// Both sides agreed: note what went each way for the journal
+template <Generation G>
+static void completeTrade() {
+    typedef GenTraits<G> T;
+    perf_tradeCompleted();
+
+    memset(&completedTrade, 0, sizeof(completedTrade));
+    completedTrade.gen = G;
+    completedTrade.mode = (uint8_t)tradeMode;
+    completedTrade.sessionMs = millis() - sessionStartMs;
+    completedTrade.boxId = -1;
+    completedTrade.savedSlot = 0xFF;
+
+    int offer = offerSlot;
+    if (offer >= 0 && offer < PARTY_LENGTH) {
+        const uint8_t* sentData = activeParty->block + T::PREAMBLE_SIZE;
+        const typename T::Mon* sent =
+            (const typename T::Mon*)(sentData + T::MON_OFFSET + offer * T::MON_SIZE);
+        completedTrade.sentSpecies = sentData[T::SPECIES_OFFSET + offer];
+        completedTrade.sentLevel = sent->level;
+    }
+    if (tradePokemon >= 0 && tradePokemon < PARTY_LENGTH) {
+        const typename T::Mon* recv =
+            (const typename T::Mon*)(recvBlock + T::MON_OFFSET + tradePokemon * T::MON_SIZE);
+        completedTrade.recvSpecies = recvBlock[T::SPECIES_OFFSET + tradePokemon];
+        completedTrade.recvLevel = recv->level;
+        completedTrade.recvOtId = ((uint16_t)recv->trainerId[0] << 8) | recv->trainerId[1];
+        memcpy(completedTrade.recvOt, recvBlock + T::OT_OFFSET + tradePokemon * T::NAME_SIZE,
+               NAME_LENGTH);
+    }
+    completedSeq = journal_append(&completedTrade);
+}
+
+template <Generation G>
+static uint8_t handleTradeCentre(uint8_t in) {
+    typedef GenTraits<G> T;
+    uint8_t send = 0x00;
+
+    switch (tcState) {
+
+    case TC_INIT:
+        if (in == 0x00) {
+            tcState = TC_READY_TO_GO;
+            send = 0x00;
+            LOG_DEBUG("[TC] INIT -> READY_TO_GO\n");
+        } else {
+            send = in;
+        }
+        break;
+
+    case TC_READY_TO_GO:
+        if (in == SERIAL_PREAMBLE_BYTE) {
+            tcState = TC_SEEN_FIRST_WAIT;
+            send = SERIAL_PREAMBLE_BYTE;
+        } else {
+            send = in;
+        }
+        break;
+
+    case TC_SEEN_FIRST_WAIT:
+        if (in != SERIAL_PREAMBLE_BYTE) {
+            tcState = TC_SENDING_RANDOM_DATA;
+            send = in;
+            counter = 0;
+        } else {
+            send = SERIAL_PREAMBLE_BYTE;
+        }
+        break;
+
+    case TC_SENDING_RANDOM_DATA:
+        if (in == SERIAL_PREAMBLE_BYTE) {
+            tcState = TC_WAITING_TO_SEND_DATA;
+            send = SERIAL_PREAMBLE_BYTE;
+            selectPreparedParty<G>();
+        } else {
+            send = in;
+        }
+        break;
+
+    case TC_WAITING_TO_SEND_DATA:
+        if (in != SERIAL_PREAMBLE_BYTE) {
+            counter = 0;
+            send = activeParty->block[T::PREAMBLE_SIZE + counter];
+            recvBlock[counter] = in;
+            counter++;
+            tcState = TC_SENDING_DATA;
+            LOG_DEBUG("[TC] SENDING_DATA (0/%d)\n", (int)T::DATA_LENGTH);
+        } else {
+            send = SERIAL_PREAMBLE_BYTE;
+        }
+        break;
+
+    case TC_SENDING_DATA:
+        send = activeParty->block[T::PREAMBLE_SIZE + counter];
+        recvBlock[counter] = in;
+        counter++;
+        if (counter >= T::DATA_LENGTH) {
+            tcState = TC_SENDING_PATCH_DATA;
+            LOG_DEBUG("[TC] Data exchange complete (%d bytes)\n", counter);
+            logReceivedParty<G>();
+            recvDecoder.begin(recvBlock, T::DATA_LENGTH);
+        }
+        break;
+
+    case TC_SENDING_PATCH_DATA:
+        if (in == SERIAL_PREAMBLE_BYTE) {
+            if (counter > 0) recvDecoder.begin(recvBlock, T::DATA_LENGTH); // List restarted
+            counter = 0;
+            send = SERIAL_PREAMBLE_BYTE;
+        } else {
+            send = activeParty->patch[3 + counter];
+            recvDecoder.feed(in);
+            counter++;
+            if (counter >= 197) {
+                tcState = TC_TRADE_PENDING;
+                LOG_DEBUG("[TC] Patch exchange complete -> TRADE_PENDING\n");
+            }
+        }
+        break;
+
+    case TC_TRADE_PENDING:
+        if ((in & 0x60) == 0x60) {
+            if (in == 0x6F) {
+                tcState = TC_READY_TO_GO;
+                send = 0x6F;
+                LOG_DEBUG("[TC] Trade cancelled -> READY_TO_GO\n");
+            } else {
+                tradePokemon = in - TRADE_POKEMON_BASE;
+                completedSeq = 0;       // A new trade; the last one's record is final
+                send = TRADE_POKEMON_BASE + offerSlot;
+                LOG_DEBUG("[TC] GB selected %d, we offer %d\n", tradePokemon, offerSlot);
+            }
+        } else if (in == 0x00) {
+            send = 0x00;
+            tcState = TC_TRADE_CONFIRMATION;
+            LOG_DEBUG("[TC] -> TRADE_CONFIRMATION\n");
+        } else {
+            send = in;
+        }
+        break;
+
+    case TC_TRADE_CONFIRMATION:
+        if ((in & 0x60) == 0x60) {
+            if (in == 0x61) {
+                tradePokemon = -1;
+                tcState = TC_TRADE_PENDING;
+                setHolding(false);
+                send = in;
+                LOG_DEBUG("[TC] Trade declined by GB -> TRADE_PENDING\n");
+            } else {
+                Verdict v = autoConfirm ? VERDICT_CONFIRM : manualVerdict();
+                if (v == VERDICT_HOLD) {
+                    send = 0x00;        // Not a choice; the GB asks again
+                } else if (v == VERDICT_CONFIRM) {
+                    send = 0x62;
+                    tcState = TC_DONE;
+                    completeTrade<G>();
+                    LOG_DEBUG("[TC] Trade %s -> DONE\n",
+                              autoConfirm ? "auto-confirmed" : "confirmed (manual)");
+                } else {
+                    send = 0x61;
+                    tradePokemon = -1;
+                    tcState = TC_TRADE_PENDING;
+                    LOG_DEBUG("[TC] Trade declined (manual) -> TRADE_PENDING\n");
+                }
+            }
         } else {
-            int monOff = 21 + i * GEN2_PARTY_STRUCT_SIZE;
-            int nickOff = 375 + i * NAME_LENGTH;
-            Gen2PartyMon* mon = (Gen2PartyMon*)(recvBlock + monOff);
-            ctx.opponentSpecies[i] = mon->species;
-            ctx.opponentLevels[i] = mon->level;
-            memcpy((void*)ctx.opponentNicknames[i], recvBlock + nickOff, NAME_LENGTH);
-            debug_logf("  [%d] %s (dex=%d) Lv%d HP=%d\n",
-                       i, gen2_getSpeciesName(mon->species),
-                       mon->species, mon->level,
-                       (mon->hp[0] << 8) | mon->hp[1]);
+            send = in;
         }
+        break;
+
+    case TC_DONE:
+        if (in == 0x00) {
+            send = 0x00;
+            tcState = TC_INIT;
+            LOG_DEBUG("[TC] DONE -> INIT (ready for next trade)\n");
+        } else {
+            send = in;
+        }
+        break;
     }
+
+    return send;
+}
+
+// =============================================================================
+// Per-generation engine — bound once when the generation becomes known
+// (connect byte, or the Time Capsule switch), never looked up per byte
+// =============================================================================
+
+struct GenEngine {
+    uint8_t (*tradeCentre)(uint8_t in);
+    void (*saveReceived)();
+};
+
+static const GenEngine GEN1_ENGINE = { handleTradeCentre<GEN_1>, saveReceivedPokemon<GEN_1> };
+static const GenEngine GEN2_ENGINE = { handleTradeCentre<GEN_2>, saveReceivedPokemon<GEN_2> };
+static const GenEngine* engine = &GEN1_ENGINE;
+
+static void bindGeneration(Generation g) {
+    gen = g;
+    engine = (g == GEN_2) ? &GEN2_ENGINE : &GEN1_ENGINE;
+}
+
+// =============================================================================
+// Framing — byte runs the protocol guarantees, checked for bit slips
+// =============================================================================
+
+static FramingExpect framingExpect() {
+    if (appState == STATE_PRINTER) return FRAMING_NONE;
+    switch (connState) {
+    case CONN_NOT_CONNECTED:
+    case CONN_CONNECTED:
+        return FRAMING_HANDSHAKE;
+    case CONN_TRADE_CENTRE:
+        switch (tcState) {
+        case TC_READY_TO_GO:
+        case TC_SEEN_FIRST_WAIT:
+        case TC_SENDING_RANDOM_DATA:
+        case TC_WAITING_TO_SEND_DATA:
+        case TC_SENDING_PATCH_DATA:
+            return FRAMING_PREAMBLE;
+        default:
+            return FRAMING_NONE;
+        }
+    default:
+        return FRAMING_NONE;
+    }
+}
+
+static void onSlip(int bits) {
+    bool fixed = link_realign(bits);
+    if (fixed) framing_realigned();
+    if (connState == CONN_TRADE_CENTRE && tcState >= TC_SENDING_DATA) recvSuspect = true;
+    LOG_WARN("[FRAME] Bytes arriving %d bit(s) late in %s, %s\n",
+             bits, connStateName(connState), fixed ? "realigned" : "transport can't realign");
 }
 
 // =============================================================================
@@ -308,21 +683,55 @@ static void logReceivedParty() {
 
 static void resetConnection() {
     ConnectionState prev = connState;
+    AppState prevApp = appState;
+    appState = STATE_IDLE;
     connState = CONN_NOT_CONNECTED;
     tcState = TC_INIT;
     gen = GEN_UNKNOWN;
     counter = 0;
-    dataLength = 0;
-    outByte = 0x00;
-    ctx.opponentCount = 0;
-    ctx.tradePokemon = -1;
-    ctx.confirmRequested = false;
-    ctx.declineRequested = false;
+    status.opponentCount = 0;
+    status.opponentVersion++;
+    statusChanged = true;
+    decisionPending = false;
+    recvSuspect = false;
+    completedSeq = 0;
+    setHolding(false);
+    capture_end();
+    framing_reset();
 
     syncContext();
 
+    if (prevApp == STATE_PRINTER) {
+        printer_reset();
+        printer_sessionEnd(millis() - sessionStartMs);
+        link_resetStats();
+    }
+
     if (prev != CONN_NOT_CONNECTED) {
-        debug_logf("[CONN] Disconnected (was %s)\n", connStateName(prev));
+        LOG_INFO("[CONN] Disconnected (was %s)\n", connStateName(prev));
+
+        LinkStats ls;
+        link_getStats(&ls);
+        LOG_INFO("[LINK] %s: %u bytes, %u overruns, overhead avg %uns max %uns, "
+                 "turnaround avg %uus max %uus\n",
+                 ls.backend, (unsigned)ls.bytes, (unsigned)ls.overruns,
+                 (unsigned)ls.avgOverheadNs, (unsigned)ls.maxOverheadNs,
+                 (unsigned)ls.avgTurnaroundUs, (unsigned)ls.maxTurnaroundUs);
+        LinkTiming lt;
+        link_getTiming(&lt);
+        LOG_INFO("[LINK] Clock %s: bit %uns, pause avg %uus max %uus, slack %dus, "
+                 "timeouts partial %uus / flush %ums\n",
+                 lt.profile, (unsigned)lt.bitNs, (unsigned)lt.gapUs, (unsigned)lt.peakGapUs,
+                 (int)lt.slackUs, (unsigned)lt.partialTimeoutUs, (unsigned)lt.flushIdleMs);
+        perf_sessionEnd(&ls);
+        link_resetStats();
+        link_resetTiming();
+
+#if LINK_BACKEND == LINK_BACKEND_SIM
+        PerfSummary ps;
+        perf_getSummary(&ps);
+        if (ps.sessions % SIM_REPORT_EVERY == 0) perf_report();
+#endif
     }
 
     led_setPattern(LED_SLOW_BLINK);
@@ -335,6 +744,16 @@ static void resetConnection() {
 static uint8_t handleByte(uint8_t in) {
     uint8_t send = 0x00;
 
+    if (appState == STATE_PRINTER) {
+        send = printer_handleByte(in);
+        if (status.printedImages != printer_printedCount()) {
+            status.printedImages = printer_printedCount();
+            statusChanged = true;
+        }
+        syncContext();
+        return send;
+    }
+
     switch (connState) {
 
     // =========================================================================
@@ -345,17 +764,29 @@ static uint8_t handleByte(uint8_t in) {
             send = PKMN_SLAVE;
         } else if (in == PKMN_BLANK) {
             send = PKMN_BLANK;
+        } else if (in == GBP_SYNC_0) {
+            // Printer packets open with 88 33; nothing in the trade handshake does
+            appState = STATE_PRINTER;
+            sessionStartMs = millis();
+            printer_reset();
+            send = printer_handleByte(in);
+            LOG_INFO("[CONN] Printer session\n");
+            led_setPattern(LED_DOUBLE_BLINK);
         } else if (in == PKMN_CONNECTED) {
             send = PKMN_CONNECTED;
+            appState = STATE_TRADE;
             connState = CONN_CONNECTED;
-            gen = GEN_1;
-            debug_logf("[CONN] Connected (Gen 1)\n");
+            sessionStartMs = millis();
+            bindGeneration(GEN_1);
+            LOG_INFO("[CONN] Connected (Gen 1)\n");
             led_setPattern(LED_DOUBLE_BLINK);
         } else if (in == PKMN_CONNECTED_GEN2) {
             send = PKMN_CONNECTED_GEN2;
+            appState = STATE_TRADE;
             connState = CONN_CONNECTED;
-            gen = GEN_2;
-            debug_logf("[CONN] Connected (Gen 2)\n");
+            sessionStartMs = millis();
+            bindGeneration(GEN_2);
+            LOG_INFO("[CONN] Connected (Gen 2)\n");
             led_setPattern(LED_DOUBLE_BLINK);
         } else {
             send = in;
@@ -376,19 +807,19 @@ static uint8_t handleByte(uint8_t in) {
             // D4: Trade Centre (native format for current gen)
             connState = CONN_TRADE_CENTRE;
             tcState = TC_INIT;
-            debug_logf("[CONN] -> TRADE_CENTRE (%s)\n", gen == GEN_1 ? "Gen1" : "Gen2");
+            LOG_INFO("[CONN] -> TRADE_CENTRE (%s)\n", gen == GEN_1 ? "Gen1" : "Gen2");
             led_setPattern(LED_TRIPLE_BLINK);
         } else if (in == COLOSSEUM) {
             connState = CONN_COLOSSEUM;
-            debug_logf("[CONN] -> COLOSSEUM (echoing)\n");
+            LOG_INFO("[CONN] -> COLOSSEUM (echoing)\n");
         } else if (in == BREAK_LINK) {
             if (gen == GEN_2) {
                 // D6 in Gen 2 = Time Capsule (switch to Gen 1 format)
-                gen = GEN_1;
+                bindGeneration(GEN_1);
                 connState = CONN_TRADE_CENTRE;
                 tcState = TC_INIT;
                 send = in;
-                debug_logf("[CONN] -> TIME CAPSULE (Gen1 format)\n");
+                LOG_INFO("[CONN] -> TIME CAPSULE (Gen1 format)\n");
                 led_setPattern(LED_TRIPLE_BLINK);
             } else {
                 // D6 in Gen 1 = Cancel/Break Link
@@ -406,152 +837,10 @@ static uint8_t handleByte(uint8_t in) {
         break;
 
     // =========================================================================
-    // TRADE_CENTRE: The main trade protocol state machine
+    // TRADE_CENTRE: generation-specific engine
     // =========================================================================
     case CONN_TRADE_CENTRE:
-        switch (tcState) {
-
-        case TC_INIT:
-            if (in == 0x00) {
-                tcState = TC_READY_TO_GO;
-                send = 0x00;
-                debug_logf("[TC] INIT -> READY_TO_GO\n");
-            } else {
-                send = in;
-            }
-            break;
-
-        case TC_READY_TO_GO:
-            if (in == SERIAL_PREAMBLE_BYTE) {
-                tcState = TC_SEEN_FIRST_WAIT;
-                send = SERIAL_PREAMBLE_BYTE;
-            } else {
-                send = in;
-            }
-            break;
-
-        case TC_SEEN_FIRST_WAIT:
-            if (in != SERIAL_PREAMBLE_BYTE) {
-                tcState = TC_SENDING_RANDOM_DATA;
-                send = in;
-                counter = 0;
-            } else {
-                send = SERIAL_PREAMBLE_BYTE;
-            }
-            break;
-
-        case TC_SENDING_RANDOM_DATA:
-            if (in == SERIAL_PREAMBLE_BYTE) {
-                tcState = TC_WAITING_TO_SEND_DATA;
-                send = SERIAL_PREAMBLE_BYTE;
-                prepareTradeData();
-            } else {
-                send = in;
-            }
-            break;
-
-        case TC_WAITING_TO_SEND_DATA:
-            if (in != SERIAL_PREAMBLE_BYTE) {
-                counter = 0;
-                send = sendBlock[GEN1_PREAMBLE_SIZE + counter];
-                recvBlock[counter] = in;
-                counter++;
-                tcState = TC_SENDING_DATA;
-                debug_logf("[TC] SENDING_DATA (0/%d)\n", dataLength);
-            } else {
-                send = SERIAL_PREAMBLE_BYTE;
-            }
-            break;
-
-        case TC_SENDING_DATA:
-            send = sendBlock[GEN1_PREAMBLE_SIZE + counter];
-            recvBlock[counter] = in;
-            counter++;
-            if (counter >= dataLength) {
-                tcState = TC_SENDING_PATCH_DATA;
-                debug_logf("[TC] Data exchange complete (%d bytes)\n", counter);
-                logReceivedParty();
-            }
-            break;
-
-        case TC_SENDING_PATCH_DATA:
-            if (in == SERIAL_PREAMBLE_BYTE) {
-                counter = 0;
-                send = SERIAL_PREAMBLE_BYTE;
-            } else {
-                send = sendPatch[3 + counter];
-                recvPatch[3 + counter] = in;
-                counter++;
-                if (counter >= 197) {
-                    recvPatch[0] = SERIAL_PREAMBLE_BYTE;
-                    recvPatch[1] = SERIAL_PREAMBLE_BYTE;
-                    recvPatch[2] = SERIAL_PREAMBLE_BYTE;
-                    tcState = TC_TRADE_PENDING;
-                    debug_logf("[TC] Patch exchange complete -> TRADE_PENDING\n");
-                }
-            }
-            break;
-
-        case TC_TRADE_PENDING:
-            if ((in & 0x60) == 0x60) {
-                if (in == 0x6F) {
-                    tcState = TC_READY_TO_GO;
-                    send = 0x6F;
-                    debug_logf("[TC] Trade cancelled -> READY_TO_GO\n");
-                } else {
-                    tradePokemon = in - TRADE_POKEMON_BASE;
-                    send = TRADE_POKEMON_BASE + ctx.offerSlot;
-                    debug_logf("[TC] GB selected %d, we offer %d\n", tradePokemon, ctx.offerSlot);
-                }
-            } else if (in == 0x00) {
-                send = 0x00;
-                tcState = TC_TRADE_CONFIRMATION;
-                debug_logf("[TC] -> TRADE_CONFIRMATION\n");
-            } else {
-                send = in;
-            }
-            break;
-
-        case TC_TRADE_CONFIRMATION:
-            if ((in & 0x60) == 0x60) {
-                if (in == 0x61) {
-                    tradePokemon = -1;
-                    tcState = TC_TRADE_PENDING;
-                    send = in;
-                    debug_logf("[TC] Trade declined by GB -> TRADE_PENDING\n");
-                } else {
-                    if (ctx.autoConfirm) {
-                        send = 0x62;
-                        tcState = TC_DONE;
-                        debug_logf("[TC] Trade auto-confirmed -> DONE\n");
-                    } else if (ctx.confirmRequested) {
-                        ctx.confirmRequested = false;
-                        send = 0x62;
-                        tcState = TC_DONE;
-                        debug_logf("[TC] Trade confirmed (manual) -> DONE\n");
-                    } else {
-                        send = 0x61;
-                        tradePokemon = -1;
-                        tcState = TC_TRADE_PENDING;
-                        ctx.declineRequested = false;
-                        debug_logf("[TC] Trade declined (manual) -> TRADE_PENDING\n");
-                    }
-                }
-            } else {
-                send = in;
-            }
-            break;
-
-        case TC_DONE:
-            if (in == 0x00) {
-                send = 0x00;
-                tcState = TC_INIT;
-                debug_logf("[TC] DONE -> INIT (ready for next trade)\n");
-            } else {
-                send = in;
-            }
-            break;
-        }
+        send = engine->tradeCentre(in);
         break;
 
     // =========================================================================
@@ -571,6 +860,25 @@ static uint8_t handleByte(uint8_t in) {
     return send;
 }
 
+#if LINK_BACKEND == LINK_BACKEND_REPLAY
+// Run each replayed session with the settings it was captured with
+static void adoptReplaySettings() {
+    static uint32_t adopted = 0;
+    if (replay_sessionId() == adopted) return;
+    adopted = replay_sessionId();
+
+    const CaptureHeader* h = replay_header();
+    tradeMode = (h->tradeMode == TRADE_MODE_STORAGE) ? TRADE_MODE_STORAGE : TRADE_MODE_CLONE;
+    offerSlot = (h->offerSlot < PARTY_LENGTH) ? h->offerSlot : 0;
+    autoConfirm = h->autoConfirm != 0;
+    status.tradeMode = tradeMode;
+    status.offerSlot = offerSlot;
+    status.autoConfirm = autoConfirm;
+    statusChanged = true;
+    syncContext();
+}
+#endif
+
 // =============================================================================
 // Arduino Entry Points
 // =============================================================================
@@ -578,55 +886,133 @@ static uint8_t handleByte(uint8_t in) {
 void setup() {
     Serial.begin(115200);
     delay(1000);
+    log_init();
 
-    debug_logf("=== PokeTool v0.3 ===\n");
-    debug_logf("Pins: MOSI=%d MISO=%d SCLK=%d LED=%d\n",
-               PIN_MOSI, PIN_MISO, PIN_SCLK, PIN_LED);
+    LOG_INFO("=== PokeTool v0.3 ===\n");
+    LOG_INFO("Pins: MOSI=%d MISO=%d SCLK=%d LED=%d\n",
+             PIN_MOSI, PIN_MISO, PIN_SCLK, PIN_LED);
 
     link_init();
     led_init();
     led_setPattern(LED_SLOW_BLINK);
 
-    storage_init();
-
-    memset(&ctx, 0, sizeof(ctx));
-    ctx.tradeMode = (int)storage_getTradeMode();
-    ctx.offerSlot = 0;
-    ctx.autoConfirm = true;
-    ctx.tradePokemon = -1;
+#if PATCH_SELFTEST
+    PatchSelfTest pt;
+    patch_selfTest(esp_random(), PATCH_SELFTEST_ROUNDS, &pt);
+    if (pt.failures) {
+        LOG_ERROR("Patch codec: %u of %u blocks differ from the reference\n",
+                  (unsigned)pt.failures, (unsigned)pt.cases);
+    } else {
+        LOG_INFO("Patch codec: %u blocks OK, encode %u us vs %u us byte-at-a-time\n",
+                 (unsigned)pt.cases, (unsigned)pt.newUs, (unsigned)pt.refUs);
+    }
+#endif
 
-    wifi_init(&ctx);
+    storage_init();
+    refreshPreparedParties();
+
+    tradeMode = storage_getTradeMode();
+    status.tradeMode = tradeMode;
+    status.offerSlot = offerSlot;
+    status.autoConfirm = autoConfirm;
+    status.holdTimeoutMs = holdTimeoutMs;
+    status.holdDefaultConfirm = holdDefaultConfirm;
+    status.tradePokemon = -1;
+    tradeStatus_publish(&ctx, &status);
+
+    wifi_init(&ctx);   // Mounts LittleFS
+    box_init();
+    journal_init();
+    capture_init();
+    gallery_init();
+    framing_init();
 
     resetConnection();
 
-    debug_logf("Ready. Connect to WiFi 'PokeTool' -> 192.168.4.1\n");
+    LOG_INFO("Ready. Connect to WiFi 'PokeTool' -> 192.168.4.1\n");
 }
 
 void loop() {
     led_update();
+    drainCommands();
 
-    int received = link_transferByte(outByte);
+    uint8_t sent;
+    int received = link_readByte(&sent, LINK_WAIT_MS);
 
     if (received < 0) {
-        // Flush any pending SPI debug data during idle
-        debug_spi_flush();
+#if LINK_BACKEND == LINK_BACKEND_REPLAY
+        adoptReplaySettings();
+#endif
+        // Nothing to answer: rebuild the outgoing party if storage changed
+        refreshPreparedParties();
+
+        // Flush any pending SPI debug data once the clock goes quiet
+        if (link_isIdle(link_flushIdleMs())) {
+            debug_spi_flush();
+        }
+
+        // Dashboard clients get state changes pushed instead of polling
+        wifi_pushState();
 
         if (link_isIdle(IDLE_TIMEOUT_MS)) {
             if (tradePokemon >= 0 && tcState < TC_TRADE_PENDING) {
-                saveReceivedPokemon();
+                if (recvSuspect) {
+                    LOG_WARN("[FRAME] Party block arrived across a bit slip; not saved\n");
+                } else {
+                    engine->saveReceived();
+                }
             }
 
-            if (connState != CONN_NOT_CONNECTED) {
+            if (connState != CONN_NOT_CONNECTED || appState != STATE_IDLE) {
                 resetConnection();
+                link_setResponse(0x00);
             }
         }
+
+        // Flash writes stall the CPU and the SCLK interrupt isn't IRAM-safe, so
+        // edges during one are lost: only write between sessions
+        if (connState == CONN_NOT_CONNECTED && appState == STATE_IDLE &&
+            link_isIdle(IDLE_TIMEOUT_MS)) {
+            if (storage_isDirty()) storage_flush();
+            if (journal_isDirty()) journal_flush();
+            if (capture_isDirty()) capture_flush();
+            if (gallery_isDirty()) gallery_flush();
+        }
+        if (status.galleryVersion != gallery_getVersion()) {
+            status.galleryVersion = gallery_getVersion();   // Saves and web deletes
+            statusChanged = true;
+            syncContext();
+        }
         return;
     }
 
     // Log SPI byte exchange
-    debug_spi(outByte, (uint8_t)received);
+    debug_spi(sent, (uint8_t)received);
+
+    int bucket = (appState == STATE_PRINTER) ? PERF_PRINTER
+               : (connState == CONN_TRADE_CENTRE) ? PERF_TC_BASE + (int)tcState : (int)connState;
+    if (connState == CONN_NOT_CONNECTED && !capture_isRecording()) {
+        capture_begin(tradeMode, offerSlot, autoConfirm);
+    }
+    ConnectionState prevConn = connState;
+    TradeCentreState prevTc = tcState;
+
+    if (link_isRealigning()) {
+        framing_reset();                // Still the old boundary; the slip was already handled
+    } else {
+        int slip = framing_check((uint8_t)received, framingExpect());
+        if (slip) onSlip(slip);
+    }
 
-    outByte = handleByte((uint8_t)received);
+    perf_handlerBegin();
+    uint8_t response = handleByte((uint8_t)received);
+    perf_handlerEnd(bucket);
 
-    delayMicroseconds(BYTE_DELAY_US);
+    link_setResponse(response);
+    if (tcState == TC_SENDING_DATA && prevTc != TC_SENDING_DATA) recvSuspect = false;
+
+    if (capture_isRecording()) {
+        capture_byte((uint8_t)received, sent, response);
+        if (connState != prevConn || tcState != prevTc) capture_state(connState, tcState);
+    }
 }
@@ -0,0 +1,171 @@
+#include "perf.h"
+#include "link_cable.h"
+#include "debug_log.h"
+
+// =============================================================================
+// Counters
+// =============================================================================
+
+// Bucket names (must match ConnectionState / TradeCentreState order in main.cpp)
+static const char* const BUCKET_NAMES[PERF_BUCKETS] = {
+    "not_connected", "connected", "trade_centre", "colosseum",
+    "init", "ready_to_go", "seen_first_wait", "sending_random",
+    "wait_to_send", "sending_data", "sending_patch",
+    "trade_pending", "trade_confirm", "done",
+    "printer"
+};
+
+struct Bucket {
+    uint32_t count;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+};
+
+static Bucket buckets[PERF_BUCKETS];
+static uint32_t handlerStart = 0;
+
+static uint32_t startMs = 0;
+static bool started = false;
+static uint32_t sessions = 0;
+static uint32_t trades = 0;
+static uint32_t turnaroundMaxUs = 0;
+static uint32_t heapFirst = 0;
+static uint32_t heapLast = 0;
+static uint32_t commands = 0;
+static uint64_t commandTotalUs = 0;
+static uint32_t commandMaxUs = 0;
+
+// Soak drift: mean handler cycles of the first and latest SIM_REPORT_EVERY
+// session windows
+static uint64_t windowCycles = 0;
+static uint32_t windowCount = 0;
+static uint32_t firstWindowAvg = 0;
+static uint32_t lastWindowAvg = 0;
+
+static inline uint32_t cyclesToNs(uint64_t cycles) {
+    return (uint32_t)(cycles * 1000 / getCpuFrequencyMhz());
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void perf_handlerBegin() {
+    if (!started) {
+        started = true;
+        startMs = millis();
+    }
+    handlerStart = ESP.getCycleCount();
+}
+
+void perf_handlerEnd(int bucket) {
+    uint32_t cycles = ESP.getCycleCount() - handlerStart;
+    if (bucket < 0 || bucket >= PERF_BUCKETS) return;
+
+    Bucket& b = buckets[bucket];
+    b.count++;
+    b.totalCycles += cycles;
+    if (cycles > b.maxCycles) b.maxCycles = cycles;
+
+    windowCycles += cycles;
+    windowCount++;
+}
+
+void perf_tradeCompleted() {
+    trades++;
+}
+
+void perf_commandApplied(uint32_t latencyUs) {
+    commands++;
+    commandTotalUs += latencyUs;
+    if (latencyUs > commandMaxUs) commandMaxUs = latencyUs;
+}
+
+void perf_sessionEnd(const LinkStats* link) {
+    sessions++;
+    if (link->maxTurnaroundUs > turnaroundMaxUs) turnaroundMaxUs = link->maxTurnaroundUs;
+
+    heapLast = ESP.getFreeHeap();
+    if (sessions == 1) heapFirst = heapLast;
+
+    if (sessions % SIM_REPORT_EVERY == 0 && windowCount > 0) {
+        lastWindowAvg = (uint32_t)(windowCycles / windowCount);
+        if (firstWindowAvg == 0) firstWindowAvg = lastWindowAvg;
+        windowCycles = 0;
+        windowCount = 0;
+    }
+}
+
+void perf_reset() {
+    memset(buckets, 0, sizeof(buckets));
+    started = false;
+    sessions = 0;
+    trades = 0;
+    turnaroundMaxUs = 0;
+    heapFirst = 0;
+    heapLast = 0;
+    commands = 0;
+    commandTotalUs = 0;
+    commandMaxUs = 0;
+    windowCycles = 0;
+    windowCount = 0;
+    firstWindowAvg = 0;
+    lastWindowAvg = 0;
+    link_resetStats();
+}
+
+void perf_getSummary(PerfSummary* out) {
+    uint32_t count = 0;
+    uint32_t maxCycles = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < PERF_BUCKETS; i++) {
+        count += buckets[i].count;
+        total += buckets[i].totalCycles;
+        if (buckets[i].maxCycles > maxCycles) maxCycles = buckets[i].maxCycles;
+    }
+
+    LinkStats ls;
+    link_getStats(&ls);
+
+    out->sessions = sessions;
+    out->trades = trades;
+    out->elapsedMs = started ? millis() - startMs : 0;
+    out->tradesPerSecX100 = out->elapsedMs ? (uint32_t)((uint64_t)trades * 100000 / out->elapsedMs) : 0;
+    out->handlerAvgNs = count ? cyclesToNs(total / count) : 0;
+    out->handlerMaxNs = cyclesToNs(maxCycles);
+    out->turnaroundMaxUs = (ls.maxTurnaroundUs > turnaroundMaxUs) ? ls.maxTurnaroundUs : turnaroundMaxUs;
+    out->overruns = ls.overruns;
+    out->heapFirst = heapFirst;
+    out->heapLast = heapLast;
+    out->heapMin = ESP.getMinFreeHeap();
+    out->driftNs = (int32_t)cyclesToNs(lastWindowAvg) - (int32_t)cyclesToNs(firstWindowAvg);
+    out->commands = commands;
+    out->commandAvgUs = commands ? (uint32_t)(commandTotalUs / commands) : 0;
+    out->commandMaxUs = commandMaxUs;
+}
+
+int perf_getStates(PerfStateStats* out, int max) {
+    int n = 0;
+    for (int i = 0; i < PERF_BUCKETS && n < max; i++) {
+        const Bucket& b = buckets[i];
+        if (b.count == 0) continue;
+        out[n].name = BUCKET_NAMES[i];
+        out[n].count = b.count;
+        out[n].avgNs = cyclesToNs(b.totalCycles / b.count);
+        out[n].maxNs = cyclesToNs(b.maxCycles);
+        n++;
+    }
+    return n;
+}
+
+void perf_report() {
+    PerfSummary s;
+    perf_getSummary(&s);
+    LOG_INFO("[PERF] sessions=%u trades=%u (%u.%02u/s) handler avg %uns max %uns "
+             "turnaround max %uus drift %dns heap %u (first %u, min %u)\n",
+             (unsigned)s.sessions, (unsigned)s.trades,
+             (unsigned)(s.tradesPerSecX100 / 100), (unsigned)(s.tradesPerSecX100 % 100),
+             (unsigned)s.handlerAvgNs, (unsigned)s.handlerMaxNs,
+             (unsigned)s.turnaroundMaxUs, (int)s.driftNs,
+             (unsigned)s.heapLast, (unsigned)s.heapFirst, (unsigned)s.heapMin);
+}
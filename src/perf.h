@@ -0,0 +1,67 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "config.h"
+
+// =============================================================================
+// Protocol performance counters
+// =============================================================================
+// Handler latency is bucketed by the state handleByte() was in when the byte
+// arrived: buckets 0-3 are ConnectionState values, buckets 4+ are
+// TradeCentreState values while in the Trade Centre, and the last one is
+// printer emulation.
+
+#define PERF_TC_BASE   4
+#define PERF_PRINTER   (PERF_TC_BASE + 10)
+#define PERF_BUCKETS   (PERF_PRINTER + 1)
+
+struct PerfStateStats {
+    const char* name;
+    uint32_t count;
+    uint32_t avgNs;
+    uint32_t maxNs;
+};
+
+struct PerfSummary {
+    uint32_t sessions;
+    uint32_t trades;
+    uint32_t elapsedMs;           // Since first byte after reset
+    uint32_t tradesPerSecX100;
+    uint32_t handlerAvgNs;        // All buckets
+    uint32_t handlerMaxNs;
+    uint32_t turnaroundMaxUs;     // Worst link turnaround over all sessions
+    uint32_t overruns;
+    uint32_t heapFirst;           // Free heap after the first session
+    uint32_t heapLast;            // Free heap after the latest session
+    uint32_t heapMin;             // Low-water mark since boot
+    int32_t driftNs;              // Latest window avg minus first window avg
+    uint32_t commands;            // Web commands applied
+    uint32_t commandAvgUs;        // Posted by the web server -> took effect in the loop
+    uint32_t commandMaxUs;
+};
+
+struct LinkStats;
+
+// Bracket one handleByte() call
+void perf_handlerBegin();
+void perf_handlerEnd(int bucket);
+
+void perf_tradeCompleted();
+
+// A web command took effect; latency is from when it was posted
+void perf_commandApplied(uint32_t latencyUs);
+
+// Fold the finished session's link stats into the totals
+void perf_sessionEnd(const LinkStats* link);
+
+// Loop task only: the counters are updated between bytes without a lock
+void perf_reset();
+void perf_getSummary(PerfSummary* out);
+
+// Fills up to max buckets (skipping empty ones); returns the count written
+int perf_getStates(PerfStateStats* out, int max);
+
+// One-line summary to the debug log
+void perf_report();
+
+#endif // PERF_H
@@ -0,0 +1,310 @@
+#include "png_stream.h"
+#include <Arduino.h>
+#include <string.h>
+
+// =============================================================================
+// PNG Encoder Implementation
+// =============================================================================
+
+static bool tablesReady = false;
+static uint16_t spread[256];            // abcdefgh -> 0a0b0c0d0e0f0g0h
+static uint32_t crcTable[256];
+static uint16_t litCode[288];           // Fixed Huffman codes, bit-reversed for LSB-first output
+static uint8_t litLen[288];
+
+static PngStats stats;
+
+static const uint16_t LEN_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LEN_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+// Distance codes 0-11 cover everything we match (1 and a line, at most PNG_LINE_BYTES)
+static const uint8_t DIST_BASE[12] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49 };
+static const uint8_t DIST_EXTRA[12] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4 };
+
+static uint16_t reverseBits(uint16_t v, int n) {
+    uint16_t r = 0;
+    for (int i = 0; i < n; i++) {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+static void buildTables() {
+    for (int b = 0; b < 256; b++) {
+        uint16_t s = 0;
+        for (int i = 0; i < 8; i++) {
+            if (b & (1 << i)) s |= 1 << (2 * i);
+        }
+        spread[b] = s;
+
+        uint32_t c = b;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        crcTable[b] = c;
+    }
+    for (int s = 0; s < 288; s++) {
+        if (s < 144)      { litCode[s] = reverseBits(0x30 + s, 8);          litLen[s] = 8; }
+        else if (s < 256) { litCode[s] = reverseBits(0x190 + s - 144, 9);   litLen[s] = 9; }
+        else if (s < 280) { litCode[s] = reverseBits(s - 256, 7);           litLen[s] = 7; }
+        else              { litCode[s] = reverseBits(0xC0 + s - 280, 8);    litLen[s] = 8; }
+    }
+    tablesReady = true;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* p, size_t n) {
+    crc = ~crc;
+    while (n--) crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// =============================================================================
+// Chunks — assembled in s->out: 4 length + 4 type + data + 4 CRC
+// =============================================================================
+
+static uint8_t* chunkBegin(PngStream* s, const char* type) {
+    uint8_t* c = s->out + s->outLen;
+    memcpy(c + 4, type, 4);
+    return c + 8;
+}
+
+static void chunkEnd(PngStream* s, uint8_t* end) {
+    uint8_t* c = s->out + s->outLen;
+    uint32_t len = end - (c + 8);
+    put32(c, len);
+    put32(end, crc32(0, c + 4, len + 4));
+    s->outLen += len + 12;
+}
+
+// =============================================================================
+// Deflate output
+// =============================================================================
+
+static void putBits(PngStream* s, uint8_t*& p, uint32_t bits, int n) {
+    s->bitBuf |= bits << s->bitCount;
+    s->bitCount += n;
+    while (s->bitCount >= 8) {
+        *p++ = s->bitBuf;
+        s->bitBuf >>= 8;
+        s->bitCount -= 8;
+    }
+}
+
+static void putSymbol(PngStream* s, uint8_t*& p, int sym) {
+    putBits(s, p, litCode[sym], litLen[sym]);
+}
+
+static void putMatch(PngStream* s, uint8_t*& p, int len, int dist) {
+    int i = 28;
+    while (LEN_BASE[i] > len) i--;
+    putSymbol(s, p, 257 + i);
+    if (LEN_EXTRA[i]) putBits(s, p, len - LEN_BASE[i], LEN_EXTRA[i]);
+
+    int d = 11;
+    while (DIST_BASE[d] > dist) d--;
+    putBits(s, p, reverseBits(d, 5), 5);
+    if (DIST_EXTRA[d]) putBits(s, p, dist - DIST_BASE[d], DIST_EXTRA[d]);
+}
+
+static int matchLength(const uint8_t* w, int pos, int end, int dist) {
+    int n = 0;
+    int max = end - pos;
+    if (max > 258) max = 258;
+    while (n < max && w[pos + n] == w[pos + n - dist]) n++;
+    return n;
+}
+
+// Greedy: the longer of "same as the byte before" and "same as the line above"
+static void deflateFixed(PngStream* s, uint8_t*& p, const uint8_t* w, int start, int end) {
+    int line = s->lineBytes;
+    for (int i = start; i < end;) {
+        int run = (s->havePrev || i - 1 >= start) ? matchLength(w, i, end, 1) : 0;
+        int above = (s->havePrev || i - line >= start) ? matchLength(w, i, end, line) : 0;
+        int len = run > above ? run : above;
+        if (len >= 3) {
+            putMatch(s, p, len, run > above ? 1 : line);
+            i += len;
+        } else {
+            putSymbol(s, p, w[i]);
+            i++;
+        }
+    }
+}
+
+// =============================================================================
+// Pieces
+// =============================================================================
+
+static void writeHeader(PngStream* s) {
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static const uint8_t SHADES[4] = { 0xFF, 0xAA, 0x55, 0x00 };
+
+    memcpy(s->out, SIGNATURE, 8);
+    s->outLen = 8;
+
+    uint8_t* p = chunkBegin(s, "IHDR");
+    put32(p, s->tiles * 8);
+    put32(p + 4, s->rows * 8);
+    p[8] = 2;                           // Bit depth
+    p[9] = 3;                           // Indexed colour
+    p[10] = 0;                          // Deflate
+    p[11] = 0;                          // Adaptive filtering (we only use None)
+    p[12] = 0;                          // No interlace
+    chunkEnd(s, p + 13);
+
+    // Pixel value = GB colour number; the print palette picks its shade
+    p = chunkBegin(s, "PLTE");
+    for (int i = 0; i < 4; i++) {
+        uint8_t shade = SHADES[(s->palette >> (2 * i)) & 3];
+        *p++ = shade;
+        *p++ = shade;
+        *p++ = shade;
+    }
+    chunkEnd(s, p);
+
+    p = chunkBegin(s, "IDAT");
+    *p++ = 0x78;                        // zlib: deflate, 32K window
+    *p++ = 0x01;
+    if (s->deflate == PNG_FIXED) putBits(s, p, 0x3, 3);     // BFINAL=1, BTYPE=01
+    chunkEnd(s, p);
+}
+
+static bool writeRow(PngStream* s) {
+    uint8_t tiles[PNG_TILE_ROW];
+    if (!s->read(s->ctx, s->next, tiles)) return false;
+
+    uint32_t t0 = micros();
+
+    // Window: previous scanline, then this tile row's 8 scanlines
+    int lineBytes = s->lineBytes;
+    int rowRaw = 8 * lineBytes;
+    uint8_t w[PNG_LINE_BYTES + PNG_ROW_RAW];
+    memcpy(w, s->prevLine, lineBytes);
+    uint8_t* line = w + lineBytes;
+    for (int y = 0; y < 8; y++, line += lineBytes) {
+        line[0] = 0;                    // Filter: None
+        const uint8_t* t = tiles + 2 * y;
+        for (int x = 0; x < s->tiles; x++, t += GBP_TILE_SIZE) {
+            uint16_t px = spread[t[0]] | spread[t[1]] << 1;
+            line[1 + 2 * x] = px >> 8;
+            line[2 + 2 * x] = px;
+        }
+    }
+
+    const uint8_t* raw = w + lineBytes;
+    uint32_t a = s->adler & 0xFFFF, b = s->adler >> 16;
+    for (int i = 0; i < rowRaw; i++) {
+        a += raw[i];
+        b += a;
+    }
+    s->adler = (b % 65521) << 16 | (a % 65521);
+
+    s->outLen = 0;
+    uint8_t* p = chunkBegin(s, "IDAT");
+    if (s->deflate == PNG_STORED) {
+        *p++ = 0x00;                    // BFINAL=0, BTYPE=00
+        *p++ = rowRaw & 0xFF;
+        *p++ = rowRaw >> 8;
+        *p++ = ~rowRaw & 0xFF;
+        *p++ = (~rowRaw >> 8) & 0xFF;
+        memcpy(p, raw, rowRaw);
+        p += rowRaw;
+    } else {
+        deflateFixed(s, p, w, lineBytes, lineBytes + rowRaw);
+    }
+    chunkEnd(s, p);
+
+    memcpy(s->prevLine, w + rowRaw, lineBytes);
+    s->havePrev = true;
+
+    uint32_t us = micros() - t0;
+    stats.rows++;
+    stats.rawBytes += rowRaw;
+    stats.encodeUs += us;
+    if (us > stats.rowMaxUs) stats.rowMaxUs = us;
+    return true;
+}
+
+static void writeTrailer(PngStream* s) {
+    s->outLen = 0;
+    uint8_t* p = chunkBegin(s, "IDAT");
+    if (s->deflate == PNG_STORED) {
+        static const uint8_t LAST[5] = { 0x01, 0x00, 0x00, 0xFF, 0xFF };   // Empty final block
+        memcpy(p, LAST, 5);
+        p += 5;
+    } else {
+        putSymbol(s, p, 256);           // End of block
+        if (s->bitCount > 0) putBits(s, p, 0, 8 - s->bitCount);
+    }
+    put32(p, s->adler);
+    chunkEnd(s, p + 4);
+
+    p = chunkBegin(s, "IEND");
+    chunkEnd(s, p);
+    s->finished = true;
+    stats.images++;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void png_begin(PngStream* s, uint8_t tiles, uint16_t rows, uint8_t palette, PngDeflate deflate,
+               PngRowReader read, void* ctx) {
+    if (!tablesReady) buildTables();
+
+    memset(s, 0, sizeof(*s));
+    s->read = read;
+    s->ctx = ctx;
+    s->tiles = (tiles > 0 && tiles <= GBP_TILES_PER_ROW) ? tiles : GBP_TILES_PER_ROW;
+    s->lineBytes = 1 + 2 * s->tiles;
+    s->rows = rows;
+    s->palette = palette ? palette : 0xE4;
+    s->deflate = deflate;
+    s->adler = 1;
+    s->next = -1;
+}
+
+size_t png_read(PngStream* s, uint8_t* buf, size_t maxLen) {
+    size_t n = 0;
+    while (n < maxLen) {
+        if (s->outPos == s->outLen) {
+            if (s->finished || s->failed) break;
+            s->outPos = 0;
+            if (s->next < 0) {
+                writeHeader(s);
+            } else if (s->next < s->rows) {
+                if (!writeRow(s)) {
+                    s->failed = true;
+                    s->outLen = 0;
+                    break;
+                }
+            } else {
+                writeTrailer(s);
+            }
+            s->next++;
+        }
+        size_t k = s->outLen - s->outPos;
+        if (k > maxLen - n) k = maxLen - n;
+        memcpy(buf + n, s->out + s->outPos, k);
+        s->outPos += k;
+        n += k;
+    }
+    stats.pngBytes += n;
+    return n;
+}
+
+void png_getStats(PngStats* out) {
+    *out = stats;
+}
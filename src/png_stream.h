@@ -0,0 +1,75 @@
+#ifndef PNG_STREAM_H
+#define PNG_STREAM_H
+
+#include "config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// Streaming PNG encoder for printer images
+// =============================================================================
+// Turns 2bpp Game Boy tiles into a (8 * tiles) x (8 * rows) PNG one tile row
+// at a time, so only one tile row (320 bytes) and one encoded piece are ever in
+// RAM. The output is a 2-bit indexed PNG whose PLTE applies the print's GB
+// palette, so pixels go straight from tile planes to scanlines through a
+// 256-entry bit-interleave table with no per-pixel remapping. Each tile row
+// becomes one IDAT chunk holding either a stored deflate block or the next
+// part of a single fixed-Huffman block (runs and repeats of the line above).
+
+// Sizes for the widest image, a full print (thumbnails use fewer tiles)
+#define PNG_WIDTH        (GBP_TILES_PER_ROW * 8)
+#define PNG_TILE_ROW     (GBP_TILES_PER_ROW * GBP_TILE_SIZE)    // Input bytes per tile row
+#define PNG_LINE_BYTES   (1 + PNG_WIDTH / 4)                    // Filter byte + 2bpp pixels
+#define PNG_ROW_RAW      (8 * PNG_LINE_BYTES)                   // Scanline bytes per tile row
+#define PNG_PIECE_MAX    (12 + PNG_ROW_RAW * 9 / 8 + 8)         // Worst-case IDAT per tile row
+
+enum PngDeflate {
+    PNG_STORED,                         // No compression, cheapest to encode
+    PNG_FIXED                           // Fixed Huffman, distance 1 and one-line matches
+};
+
+// Fills one tile row (tiles * GBP_TILE_SIZE bytes); false if the image went away
+typedef bool (*PngRowReader)(void* ctx, int row, uint8_t* tiles);
+
+struct PngStream {
+    PngRowReader read;
+    void* ctx;
+    uint16_t rows;                      // Tile rows in the image
+    uint8_t tiles;                      // Tiles per row, up to GBP_TILES_PER_ROW
+    uint8_t lineBytes;                  // Filter byte + 2 bytes per tile
+    int16_t next;                       // Next tile row to encode (-1 = header)
+    uint8_t palette;
+    uint8_t deflate;                    // PngDeflate
+    bool finished;                      // IEND is in out[]
+    bool failed;                        // Reader gave up mid-image
+
+    uint32_t adler;                     // zlib checksum of the scanlines so far
+    uint32_t bitBuf;                    // Fixed Huffman bits not yet written
+    uint8_t bitCount;
+    bool havePrev;
+    uint8_t prevLine[PNG_LINE_BYTES];   // Last scanline, for matches across tile rows
+
+    uint8_t out[PNG_PIECE_MAX];         // Current piece
+    uint16_t outLen;
+    uint16_t outPos;
+};
+
+struct PngStats {
+    uint32_t images;                    // Streams that reached IEND
+    uint32_t rows;                      // Tile rows encoded
+    uint32_t rawBytes;                  // Scanline bytes in
+    uint32_t pngBytes;                  // PNG bytes out
+    uint32_t encodeUs;                  // Time spent encoding rows
+    uint32_t rowMaxUs;                  // Slowest tile row
+};
+
+// Palette 0 is treated as the identity palette 0xE4
+void png_begin(PngStream* s, uint8_t tiles, uint16_t rows, uint8_t palette, PngDeflate deflate,
+               PngRowReader read, void* ctx);
+
+// Copy up to maxLen more PNG bytes into buf; 0 = done (or failed)
+size_t png_read(PngStream* s, uint8_t* buf, size_t maxLen);
+
+void png_getStats(PngStats* out);
+
+#endif // PNG_STREAM_H
@@ -0,0 +1,335 @@
+#include "printer.h"
+#include "debug_log.h"
+#include <Arduino.h>
+#include <string.h>
+
+// =============================================================================
+// Printer Emulation Implementation
+// Everything here runs per byte on the loop task: no allocation, no flash,
+// and the longest step (an RLE run) is a memset of at most 129 bytes.
+// =============================================================================
+
+#define GBP_ROW_BYTES (GBP_TILES_PER_ROW * GBP_TILE_SIZE)
+
+enum PacketPhase {
+    PKT_SYNC_0,
+    PKT_SYNC_1,
+    PKT_COMMAND,
+    PKT_COMPRESSION,
+    PKT_LENGTH_LO,
+    PKT_LENGTH_HI,
+    PKT_DATA,
+    PKT_CHECKSUM_LO,
+    PKT_CHECKSUM_HI,
+    PKT_ACK,                            // First trailing 00 (device ID goes out)
+    PKT_STATUS                          // Second trailing 00 (status goes out)
+};
+
+static PacketPhase phase = PKT_SYNC_0;
+static uint8_t command = 0;
+static bool compressed = false;
+static uint16_t length = 0;
+static uint16_t remaining = 0;
+static uint16_t sum = 0;
+static uint16_t checksum = 0;
+static uint8_t params[4];               // PRINT: sheets, margins, palette, exposure
+
+// RLE decoder: a control byte, then either n+1 literals or one byte repeated n+2 times
+static uint8_t rleLeft = 0;
+static bool rleRun = false;
+
+static uint8_t status = 0;
+static uint8_t busyInquiries = 0;       // INQUIRY answers left with BUSY set
+
+// FIFO of printed images; images[head] collects the next one while claimed
+static PrinterImage images[MAX_PRINTER_IMAGES];
+static int head = 0;
+static int count = 0;
+static bool claimed = false;
+static uint16_t fill = 0;               // Bytes decoded into images[head]
+static uint16_t packetStart = 0;        // fill before the current DATA packet
+static uint32_t nextId = 1;
+
+static PrinterStats stats;
+static PrinterStats reported;           // At the previous printer_sessionEnd()
+
+// Take images[head] for new data, pushing the oldest image out if it's in use
+static void claimSlot() {
+    if (count == MAX_PRINTER_IMAGES) {
+        count--;
+        stats.droppedImages++;
+    }
+    __atomic_store_n(&images[head].id, 0, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_RELEASE);   // Readers see id 0 before new data
+    claimed = true;
+}
+
+static void emit(uint8_t b) {
+    if (fill >= GBP_MAX_IMAGE_SIZE) {
+        stats.overflowBytes++;
+        return;
+    }
+    if (!claimed) claimSlot();
+    images[head].data[fill++] = b;
+}
+
+static void emitRun(uint8_t b, uint8_t n) {
+    if (!claimed) claimSlot();
+    uint16_t room = GBP_MAX_IMAGE_SIZE - fill;
+    if (n > room) {
+        stats.overflowBytes += n - room;
+        n = room;
+    }
+    memset(images[head].data + fill, b, n);
+    fill += n;
+}
+
+static void decodeData(uint8_t in) {
+    if (!compressed) {
+        emit(in);
+    } else if (rleLeft == 0) {
+        rleRun = (in & 0x80) != 0;
+        rleLeft = rleRun ? (in & 0x7F) + 2 : in + 1;
+    } else if (rleRun) {
+        emitRun(in, rleLeft);
+        rleLeft = 0;
+    } else {
+        emit(in);
+        rleLeft--;
+    }
+}
+
+// Discard everything decoded since INIT
+static void clearImage() {
+    fill = 0;
+    packetStart = 0;
+    status = 0;
+    busyInquiries = 0;
+}
+
+static void printImage() {
+    // Only whole tile rows print; PRINT with nothing buffered just feeds paper
+    uint16_t rows = fill / GBP_ROW_BYTES;
+    if (rows == 0) return;
+
+    PrinterImage* img = &images[head];
+    img->printedMs = millis();
+    img->length = rows * GBP_ROW_BYTES;
+    img->sheets = params[0];
+    img->margins = params[1];
+    img->palette = params[2];
+    img->exposure = params[3];
+    __atomic_store_n(&img->id, nextId++, __ATOMIC_RELEASE);
+
+    head = (head + 1) % MAX_PRINTER_IMAGES;
+    count++;
+    claimed = false;
+    stats.images++;
+
+    LOG_INFO("[GBP] Printed image %u: %u rows, margins %02X, palette %02X\n",
+             (unsigned)img->id, (unsigned)rows, params[1], params[2]);
+    fill = 0;
+    packetStart = 0;
+}
+
+// Checksum verified: act on the command and settle the status we answer with
+static void applyPacket() {
+    switch (command) {
+    case GBP_CMD_INIT:
+        clearImage();
+        break;
+    case GBP_CMD_DATA:
+        if (length > 0) {
+            status |= GBP_STATUS_UNPROC;
+        } else {
+            status |= GBP_STATUS_FULL;     // Empty DATA = end of image
+        }
+        break;
+    case GBP_CMD_PRINT:
+        printImage();
+        status = (status & ~GBP_STATUS_UNPROC) | GBP_STATUS_BUSY;
+        busyInquiries = GBP_BUSY_INQUIRIES;
+        break;
+    case GBP_CMD_BREAK:
+        clearImage();
+        break;
+    case GBP_CMD_INQUIRY:
+        if (busyInquiries > 0 && --busyInquiries == 0) {
+            status &= ~(GBP_STATUS_BUSY | GBP_STATUS_FULL);
+        }
+        break;
+    }
+}
+
+static void endPacket() {
+    if (sum == checksum) {
+        status &= ~GBP_STATUS_CHECKSUM;
+        applyPacket();
+    } else {
+        // DATA was decoded as it arrived; take it back out
+        fill = packetStart;
+        status |= GBP_STATUS_CHECKSUM;
+        stats.checksumErrors++;
+        LOG_WARN("[GBP] Checksum mismatch (cmd %02X): got %04X, computed %04X\n",
+                 command, checksum, sum);
+    }
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void printer_reset() {
+    phase = PKT_SYNC_0;
+    rleLeft = 0;
+}
+
+uint8_t printer_handleByte(uint8_t in) {
+    uint8_t send = 0x00;
+
+    switch (phase) {
+    case PKT_SYNC_0:
+        if (in == GBP_SYNC_0) phase = PKT_SYNC_1;
+        break;
+
+    case PKT_SYNC_1:
+        if (in == GBP_SYNC_1) {
+            phase = PKT_COMMAND;
+        } else if (in != GBP_SYNC_0) {
+            phase = PKT_SYNC_0;
+        }
+        break;
+
+    case PKT_COMMAND:
+        command = in;
+        sum = in;
+        phase = PKT_COMPRESSION;
+        break;
+
+    case PKT_COMPRESSION:
+        compressed = (in & 0x01) != 0;
+        sum += in;
+        phase = PKT_LENGTH_LO;
+        break;
+
+    case PKT_LENGTH_LO:
+        length = in;
+        sum += in;
+        phase = PKT_LENGTH_HI;
+        break;
+
+    case PKT_LENGTH_HI:
+        length |= (uint16_t)in << 8;
+        sum += in;
+        remaining = length;
+        packetStart = fill;
+        rleLeft = 0;
+        phase = (length > 0) ? PKT_DATA : PKT_CHECKSUM_LO;
+        break;
+
+    case PKT_DATA:
+        sum += in;
+        if (command == GBP_CMD_DATA) {
+            decodeData(in);
+        } else if (command == GBP_CMD_PRINT && length - remaining < (int)sizeof(params)) {
+            params[length - remaining] = in;
+        }
+        if (--remaining == 0) phase = PKT_CHECKSUM_LO;
+        break;
+
+    case PKT_CHECKSUM_LO:
+        checksum = in;
+        phase = PKT_CHECKSUM_HI;
+        break;
+
+    case PKT_CHECKSUM_HI:
+        checksum |= (uint16_t)in << 8;
+        endPacket();
+        send = GBP_DEVICE_ID;
+        phase = PKT_ACK;
+        break;
+
+    case PKT_ACK:
+        send = status;
+        phase = PKT_STATUS;
+        break;
+
+    case PKT_STATUS:
+        stats.packets++;
+        phase = PKT_SYNC_0;
+        break;
+    }
+
+    return send;
+}
+
+uint32_t printer_printedCount() {
+    return stats.images;
+}
+
+int printer_imageCount() {
+    return count;
+}
+
+const PrinterImage* printer_image(int index) {
+    if (index < 0 || index >= count) return nullptr;
+    return &images[(head - count + index + MAX_PRINTER_IMAGES) % MAX_PRINTER_IMAGES];
+}
+
+int printer_listImages(PrinterImageInfo* out, int max) {
+    int n = 0;
+    for (int i = 0; i < MAX_PRINTER_IMAGES && n < max; i++) {
+        const PrinterImage* img = &images[i];
+        uint32_t id = __atomic_load_n(&img->id, __ATOMIC_ACQUIRE);
+        if (id == 0) continue;
+
+        PrinterImageInfo info;
+        info.id = id;
+        info.printedMs = img->printedMs;
+        info.rows = img->length / GBP_ROW_BYTES;
+        info.sheets = img->sheets;
+        info.margins = img->margins;
+        info.palette = img->palette;
+        info.exposure = img->exposure;
+        if (__atomic_load_n(&img->id, __ATOMIC_ACQUIRE) != id) continue;
+
+        // Slots are reused round-robin; keep the list in print order
+        int j = n++;
+        while (j > 0 && out[j - 1].id > id) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = info;
+    }
+    return n;
+}
+
+bool printer_readRow(uint32_t id, int row, uint8_t* tiles) {
+    for (int i = 0; i < MAX_PRINTER_IMAGES; i++) {
+        const PrinterImage* img = &images[i];
+        if (__atomic_load_n(&img->id, __ATOMIC_ACQUIRE) != id) continue;
+        if (row < 0 || (row + 1) * GBP_ROW_BYTES > img->length) return false;
+        memcpy(tiles, img->data + row * GBP_ROW_BYTES, GBP_ROW_BYTES);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&img->id, __ATOMIC_ACQUIRE) == id;
+    }
+    return false;
+}
+
+void printer_getStats(PrinterStats* out) {
+    *out = stats;
+}
+
+void printer_sessionEnd(uint32_t sessionMs) {
+    uint32_t packets = stats.packets - reported.packets;
+    uint32_t perSecX100 = sessionMs ? (uint32_t)((uint64_t)packets * 100000 / sessionMs) : 0;
+    LOG_INFO("[GBP] %u packets in %ums (%u.%02u/s), %u images, %u checksum errors, "
+             "%u dropped, %u overflow bytes\n",
+             (unsigned)packets, (unsigned)sessionMs,
+             (unsigned)(perSecX100 / 100), (unsigned)(perSecX100 % 100),
+             (unsigned)(stats.images - reported.images),
+             (unsigned)(stats.checksumErrors - reported.checksumErrors),
+             (unsigned)(stats.droppedImages - reported.droppedImages),
+             (unsigned)(stats.overflowBytes - reported.overflowBytes));
+    reported = stats;
+}
@@ -0,0 +1,70 @@
+#ifndef PRINTER_H
+#define PRINTER_H
+
+#include "config.h"
+#include <stdint.h>
+
+// =============================================================================
+// Game Boy Printer Emulation
+// =============================================================================
+// A streaming parser for the printer protocol, fed one byte at a time from
+// the same loop as handleByte(). Each packet is
+//   88 33 | cmd | compression | len lo/hi | data... | checksum lo/hi | 00 00
+// where we answer GBP_DEVICE_ID to the first trailing 00 and the status byte
+// to the second (each answer goes out with the following byte, as always).
+// DATA payloads are RLE-decompressed as they arrive; PRINT moves the image
+// into a fixed FIFO of MAX_PRINTER_IMAGES, dropping the oldest when full.
+
+struct PrinterImage {
+    uint32_t id;                        // Increments per print; 0 = slot being refilled
+    uint32_t printedMs;                 // millis() at PRINT
+    uint16_t length;                    // Tile data bytes (whole 20-tile rows)
+    uint8_t sheets;                     // PRINT parameters, as sent
+    uint8_t margins;                    // High nibble before, low nibble after
+    uint8_t palette;                    // 2 bits per shade, 0xE4 = identity
+    uint8_t exposure;
+    uint8_t data[GBP_MAX_IMAGE_SIZE];   // 2bpp tiles, GBP_TILES_PER_ROW per row
+};
+
+// Header of a printed image, as read from another task
+struct PrinterImageInfo {
+    uint32_t id;
+    uint32_t printedMs;
+    uint16_t rows;                      // Tile rows (8 pixels each)
+    uint8_t sheets;
+    uint8_t margins;
+    uint8_t palette;
+    uint8_t exposure;
+};
+
+struct PrinterStats {
+    uint32_t packets;                   // Complete packets, any command
+    uint32_t checksumErrors;            // Packets discarded for a bad checksum
+    uint32_t images;                    // PRINT commands with image data
+    uint32_t droppedImages;             // Pushed out of a full FIFO
+    uint32_t overflowBytes;             // Decompressed past GBP_MAX_IMAGE_SIZE
+};
+
+// Link dropped: resync on the next 88 33. Buffered image data is kept,
+// like the real printer, until INIT.
+void printer_reset();
+
+// Feed one received byte; returns the byte to stage as our response
+uint8_t printer_handleByte(uint8_t in);
+
+// Printed images, oldest first (loop task)
+uint32_t printer_printedCount();        // Since boot; changes on every print
+int printer_imageCount();
+const PrinterImage* printer_image(int index);
+
+// Web side (any task). A slot is re-used only after its id is cleared, so a
+// reader copies first and re-checks the id; false means the image was dropped.
+int printer_listImages(PrinterImageInfo* out, int max);     // Oldest first
+bool printer_readRow(uint32_t id, int row, uint8_t* tiles); // One tile row, GBP_TILES_PER_ROW tiles
+
+void printer_getStats(PrinterStats* out);
+
+// Log packet rate and results since the previous call (loop task)
+void printer_sessionEnd(uint32_t sessionMs);
+
+#endif // PRINTER_H
@@ -0,0 +1,45 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+
+// =============================================================================
+// Single-producer / single-consumer lock-free ring
+// =============================================================================
+// One context calls push(), one other context calls pop(). The producer may be
+// an ISR. N must be a power of two; head and tail run free and are masked on
+// access, so all N slots are usable. Methods are forced inline so ISR callers
+// in IRAM never jump to flash.
+
+template <typename T, uint32_t N>
+struct SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+    T slots[N];
+    volatile uint32_t head = 0;   // Next slot to write (producer owned)
+    volatile uint32_t tail = 0;   // Next slot to read (consumer owned)
+
+    __attribute__((always_inline)) bool push(const T& value) {
+        uint32_t h = head;
+        if (h - tail >= N) return false; // Full
+        slots[h & (N - 1)] = value;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        head = h + 1;
+        return true;
+    }
+
+    __attribute__((always_inline)) bool pop(T* out) {
+        uint32_t t = tail;
+        if (t == head) return false; // Empty
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        *out = slots[t & (N - 1)];
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        tail = t + 1;
+        return true;
+    }
+
+    uint32_t count() const { return head - tail; }
+    bool empty() const { return head == tail; }
+};
+
+#endif // SPSC_RING_H
@@ -1,5 +1,7 @@
 #include "storage.h"
 #include <Preferences.h>
+#include <esp_system.h>
+#include <stddef.h>
 #include <string.h>
 
 // =============================================================================
@@ -9,8 +11,24 @@
 static Preferences prefs;
 static StoredPokemon gen1Party[PARTY_LENGTH];
 static StoredPokemon gen2Party[PARTY_LENGTH];
-
-// NVS key builders — keys like "g1_m0", "g1_o0", "g1_n0", "g1_s0"
+static volatile uint32_t version = 0;
+
+// Write-behind state: the RAM cache is authoritative; flash catches up in
+// storage_flush(). Guarded by storageMux (web task vs loop task).
+#define DIRTY_GEN1  0x01
+#define DIRTY_GEN2  0x02
+#define DIRTY_MODE  0x04
+
+static portMUX_TYPE storageMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t dirty = 0;
+static volatile uint8_t tradeMode = TRADE_MODE_CLONE;
+static StoredPokemon flushParty[PARTY_LENGTH];   // Snapshot taken under the lock
+static uint32_t commits = 0;
+static uint32_t coalesced = 0;
+static uint32_t failures = 0;
+static uint32_t failedMs = 0;           // Last failed commit, for STORAGE_RETRY_MS
+
+// Legacy per-field layout (pre packed record) — keys like "g1_m0", "g1_o0", "g1_n0", "g1_s0"
 static void slotKey(char* buf, const char* prefix, int slot) {
     // e.g. prefix="g1_m", slot=3 -> "g1_m3"
     int len = strlen(prefix);
@@ -48,62 +66,203 @@ static void loadSlot(const char* genPrefix, int slot, StoredPokemon* out) {
     out->occupied = true;
 }
 
-static void saveSlotNVS(const char* genPrefix, int slot, const StoredPokemon* mon) {
+static void clearLegacySlot(const char* genPrefix, int slot) {
     char key[8];
-    int monSize = (genPrefix[1] == '1') ? GEN1_PARTY_STRUCT_SIZE : GEN2_PARTY_STRUCT_SIZE;
-
     slotKey(key, genPrefix, slot);
-    key[3] = 'm';
-    prefs.putBytes(key, mon->monData, monSize);
+    key[3] = 'm'; prefs.remove(key);
+    key[3] = 'o'; prefs.remove(key);
+    key[3] = 'n'; prefs.remove(key);
+    key[3] = 's'; prefs.remove(key);
+}
 
-    key[3] = 'o';
-    prefs.putBytes(key, mon->ot, NAME_LENGTH);
+// =============================================================================
+// Packed Party Record
+// One NVS blob per generation ("g1"/"g2"): header + 6 slots, each with a CRC.
+// =============================================================================
 
-    key[3] = 'n';
-    prefs.putBytes(key, mon->nickname, NAME_LENGTH);
+#define STORAGE_FORMAT_VERSION 1
+
+struct PackedSlot {
+    uint8_t monData[GEN2_PARTY_STRUCT_SIZE];
+    uint8_t ot[NAME_LENGTH];
+    uint8_t nickname[NAME_LENGTH];
+    uint8_t speciesIndex;
+    uint8_t occupied;
+    uint16_t crc;                           // CRC-16/CCITT over the bytes above
+};
+
+struct PackedParty {
+    uint8_t format;                         // STORAGE_FORMAT_VERSION
+    uint8_t gen;                            // 1 or 2
+    uint8_t slotCount;                      // PARTY_LENGTH
+    uint8_t reserved;
+    PackedSlot slots[PARTY_LENGTH];
+};
+
+static_assert(sizeof(PackedSlot) == 74, "PackedSlot layout changed");
+static_assert(sizeof(PackedParty) == 4 + 74 * PARTY_LENGTH, "PackedParty layout changed");
+
+static PackedParty packBuf;
+static PackedParty verifyBuf;               // saveParty() read-back
+
+static uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
 
-    key[3] = 's';
-    prefs.putUChar(key, mon->speciesIndex);
+static const char* partyKey(Generation gen) {
+    return (gen == GEN_1) ? "g1" : "g2";
 }
 
-static void clearSlotNVS(const char* genPrefix, int slot) {
-    char key[8];
-    slotKey(key, genPrefix, slot);
-    key[3] = 'm'; prefs.remove(key);
-    key[3] = 'o'; prefs.remove(key);
-    key[3] = 'n'; prefs.remove(key);
-    key[3] = 's'; prefs.remove(key);
+static void packParty(Generation gen, const StoredPokemon* party, PackedParty* out) {
+    memset(out, 0, sizeof(PackedParty));
+    out->format = STORAGE_FORMAT_VERSION;
+    out->gen = (gen == GEN_1) ? 1 : 2;
+    out->slotCount = PARTY_LENGTH;
+
+    for (int i = 0; i < PARTY_LENGTH; i++) {
+        PackedSlot* ps = &out->slots[i];
+        if (party[i].occupied) {
+            memcpy(ps->monData, party[i].monData, sizeof(ps->monData));
+            memcpy(ps->ot, party[i].ot, NAME_LENGTH);
+            memcpy(ps->nickname, party[i].nickname, NAME_LENGTH);
+            ps->speciesIndex = party[i].speciesIndex;
+            ps->occupied = 1;
+        }
+        ps->crc = crc16((const uint8_t*)ps, offsetof(PackedSlot, crc));
+    }
+}
+
+// Single read of a generation's record; slots failing their CRC load empty
+static bool loadParty(Generation gen, StoredPokemon* party) {
+    const char* key = partyKey(gen);
+    if (prefs.getBytesLength(key) != sizeof(PackedParty) ||
+        prefs.getBytes(key, &packBuf, sizeof(PackedParty)) != sizeof(PackedParty)) {
+        Serial.printf("[STORAGE] %s record has wrong size, ignored\n", key);
+        return false;
+    }
+    if (packBuf.format != STORAGE_FORMAT_VERSION || packBuf.slotCount != PARTY_LENGTH) {
+        Serial.printf("[STORAGE] %s record has unknown format %d, ignored\n", key, packBuf.format);
+        return false;
+    }
+
+    for (int i = 0; i < PARTY_LENGTH; i++) {
+        const PackedSlot* ps = &packBuf.slots[i];
+        memset(&party[i], 0, sizeof(StoredPokemon));
+        if (crc16((const uint8_t*)ps, offsetof(PackedSlot, crc)) != ps->crc) {
+            Serial.printf("[STORAGE] %s slot %d failed CRC, discarded\n", key, i);
+            continue;
+        }
+        if (!ps->occupied) continue;
+        memcpy(party[i].monData, ps->monData, sizeof(ps->monData));
+        memcpy(party[i].ot, ps->ot, NAME_LENGTH);
+        memcpy(party[i].nickname, ps->nickname, NAME_LENGTH);
+        party[i].speciesIndex = ps->speciesIndex;
+        party[i].occupied = true;
+    }
+    return true;
+}
+
+// Write a generation's record and read it back. False if NVS took fewer
+// bytes (e.g. full) or the stored copy differs.
+static bool saveParty(Generation gen, const StoredPokemon* party) {
+    const char* key = partyKey(gen);
+    packParty(gen, party, &packBuf);
+    if (prefs.putBytes(key, &packBuf, sizeof(PackedParty)) != sizeof(PackedParty)) {
+        Serial.printf("[STORAGE] %s record write failed\n", key);
+        return false;
+    }
+    if (prefs.getBytes(key, &verifyBuf, sizeof(PackedParty)) != sizeof(PackedParty) ||
+        memcmp(&verifyBuf, &packBuf, sizeof(PackedParty)) != 0) {
+        Serial.printf("[STORAGE] %s record failed read-back\n", key);
+        return false;
+    }
+    return true;
+}
+
+// One-time move from the per-field key layout to the packed record. The
+// legacy keys are the only copy until the record is verified, so a failed
+// save leaves them (and drops the bad record) to retry next boot.
+static void migrateLegacy(Generation gen, StoredPokemon* party) {
+    const char* prefix = (gen == GEN_1) ? "g1_x" : "g2_x";
+    int migrated = 0;
+
+    for (int i = 0; i < PARTY_LENGTH; i++) {
+        loadSlot(prefix, i, &party[i]);
+        if (party[i].occupied) migrated++;
+    }
+    if (!saveParty(gen, party)) {
+        prefs.remove(partyKey(gen));
+        Serial.printf("[STORAGE] %s migration failed, legacy keys kept\n",
+                      gen == GEN_1 ? "Gen1" : "Gen2");
+        return;
+    }
+    for (int i = 0; i < PARTY_LENGTH; i++) {
+        clearLegacySlot(prefix, i);
+    }
+
+    Serial.printf("[STORAGE] Migrated %d %s Pokemon to packed record\n",
+                  migrated, gen == GEN_1 ? "Gen1" : "Gen2");
 }
 
 // =============================================================================
 // Public API
 // =============================================================================
 
+static uint8_t dirtyBit(Generation gen) {
+    return (gen == GEN_1) ? DIRTY_GEN1 : DIRTY_GEN2;
+}
+
+static void markDirty(uint8_t bit) {
+    // Caller holds storageMux
+    if (dirty & bit) coalesced++;
+    dirty |= bit;
+}
+
+static void onShutdown() {
+    storage_flush();
+}
+
 void storage_init() {
     prefs.begin("poketool", false);
 
     memset(gen1Party, 0, sizeof(gen1Party));
     memset(gen2Party, 0, sizeof(gen2Party));
 
-    for (int i = 0; i < PARTY_LENGTH; i++) {
-        loadSlot("g1_x", i, &gen1Party[i]);
-        loadSlot("g2_x", i, &gen2Party[i]);
-    }
+    // A record that exists but won't load is left alone; the next save replaces it
+    if (prefs.isKey(partyKey(GEN_1))) loadParty(GEN_1, gen1Party);
+    else migrateLegacy(GEN_1, gen1Party);
+    if (prefs.isKey(partyKey(GEN_2))) loadParty(GEN_2, gen2Party);
+    else migrateLegacy(GEN_2, gen2Party);
 
     int g1 = storage_getCount(GEN_1);
     int g2 = storage_getCount(GEN_2);
     Serial.printf("[STORAGE] Loaded %d Gen1, %d Gen2 Pokemon from NVS\n", g1, g2);
+
+    tradeMode = prefs.getUChar("mode", (uint8_t)TRADE_MODE_CLONE);
+
+    // Covers esp_restart() (web/OTA/panic-free resets); a brownout resets
+    // without running handlers, so idle flushing keeps that window short
+    esp_register_shutdown_handler(onShutdown);
 }
 
 void storage_saveSlot(Generation gen, int slot, const StoredPokemon* mon) {
     if (slot < 0 || slot >= PARTY_LENGTH) return;
 
     StoredPokemon* party = (gen == GEN_1) ? gen1Party : gen2Party;
-    const char* prefix = (gen == GEN_1) ? "g1_x" : "g2_x";
 
+    portENTER_CRITICAL(&storageMux);
     memcpy(&party[slot], mon, sizeof(StoredPokemon));
     party[slot].occupied = true;
-    saveSlotNVS(prefix, slot, mon);
+    version++;
+    markDirty(dirtyBit(gen));
+    portEXIT_CRITICAL(&storageMux);
 
     Serial.printf("[STORAGE] Saved %s slot %d (species=0x%02X)\n",
                   gen == GEN_1 ? "Gen1" : "Gen2", slot, mon->speciesIndex);
@@ -113,11 +272,13 @@ void storage_clearSlot(Generation gen, int slot) {
     if (slot < 0 || slot >= PARTY_LENGTH) return;
 
     StoredPokemon* party = (gen == GEN_1) ? gen1Party : gen2Party;
-    const char* prefix = (gen == GEN_1) ? "g1_x" : "g2_x";
 
+    portENTER_CRITICAL(&storageMux);
     memset(&party[slot], 0, sizeof(StoredPokemon));
     party[slot].occupied = false;
-    clearSlotNVS(prefix, slot);
+    version++;
+    markDirty(dirtyBit(gen));
+    portEXIT_CRITICAL(&storageMux);
 
     Serial.printf("[STORAGE] Cleared %s slot %d\n",
                   gen == GEN_1 ? "Gen1" : "Gen2", slot);
@@ -136,12 +297,83 @@ StoredPokemon* storage_getParty(Generation gen) {
     return (gen == GEN_1) ? gen1Party : gen2Party;
 }
 
+uint32_t storage_getVersion() {
+    return version;
+}
+
+// A commit that failed leaves its record dirty in RAM and is retried later
+static void flushFailed(uint8_t bit) {
+    portENTER_CRITICAL(&storageMux);
+    dirty |= bit;
+    portEXIT_CRITICAL(&storageMux);
+    failures++;
+    failedMs = millis();
+}
+
+int storage_flush() {
+    int written = 0;
+
+    for (int g = 0; g < 2; g++) {
+        Generation gen = g ? GEN_2 : GEN_1;
+        uint8_t bit = dirtyBit(gen);
+
+        // Snapshot and clear under the lock; a save racing the flash write
+        // re-marks the record and is picked up next time
+        portENTER_CRITICAL(&storageMux);
+        bool pending = dirty & bit;
+        if (pending) {
+            memcpy(flushParty, storage_getParty(gen), sizeof(flushParty));
+            dirty &= ~bit;
+        }
+        portEXIT_CRITICAL(&storageMux);
+
+        if (pending) {
+            if (saveParty(gen, flushParty)) {
+                written++;
+            } else {
+                flushFailed(bit);
+            }
+        }
+    }
+
+    portENTER_CRITICAL(&storageMux);
+    bool modePending = dirty & DIRTY_MODE;
+    uint8_t mode = tradeMode;
+    dirty &= ~DIRTY_MODE;
+    portEXIT_CRITICAL(&storageMux);
+
+    if (modePending) {
+        if (prefs.putUChar("mode", mode) == 1) {
+            written++;
+        } else {
+            flushFailed(DIRTY_MODE);
+        }
+    }
+
+    commits += written;
+    return written;
+}
+
+bool storage_isDirty() {
+    if (failures && millis() - failedMs < STORAGE_RETRY_MS) return false;
+    return dirty != 0;
+}
+
+void storage_getWriteStats(uint32_t* outCommits, uint32_t* outCoalesced, uint32_t* outFailures) {
+    *outCommits = commits;
+    *outCoalesced = coalesced;
+    *outFailures = failures;
+}
+
 void storage_setTradeMode(TradeMode mode) {
-    prefs.putUChar("mode", (uint8_t)mode);
+    portENTER_CRITICAL(&storageMux);
+    tradeMode = (uint8_t)mode;
+    markDirty(DIRTY_MODE);
+    portEXIT_CRITICAL(&storageMux);
     Serial.printf("[STORAGE] Trade mode set to %s\n",
                   mode == TRADE_MODE_CLONE ? "clone" : "storage");
 }
 
 TradeMode storage_getTradeMode() {
-    return (TradeMode)prefs.getUChar("mode", (uint8_t)TRADE_MODE_CLONE);
+    return (TradeMode)tradeMode;
 }
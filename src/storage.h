@@ -19,22 +19,38 @@ struct StoredPokemon {
 // Storage API
 // =============================================================================
 
-// Load all slots from NVS into RAM cache
+// Load all slots from NVS into RAM cache (migrating the old per-field keys once)
 void storage_init();
 
-// Save a Pokemon to a slot (writes to NVS + RAM cache)
+// Save a Pokemon to a slot (RAM cache now, NVS on the next storage_flush)
 void storage_saveSlot(Generation gen, int slot, const StoredPokemon* mon);
 
-// Clear a slot (removes from NVS + RAM cache)
+// Clear a slot (RAM cache now, NVS on the next storage_flush)
 void storage_clearSlot(Generation gen, int slot);
 
+// Commit dirty records to NVS; one write per changed record, however many
+// saves hit it since the last flush. Call only between sessions. A record
+// that fails to commit stays dirty. Returns the number of records written.
+int storage_flush();
+
+// True while changes are waiting for storage_flush (false for
+// STORAGE_RETRY_MS after a failed commit)
+bool storage_isDirty();
+
+// Records committed, saves folded into an already-pending commit, and
+// commits that failed (retried later)
+void storage_getWriteStats(uint32_t* commits, uint32_t* coalesced, uint32_t* failures);
+
 // Count occupied slots for a generation
 int storage_getCount(Generation gen);
 
 // Get the RAM-cached slot array (6 slots) for a generation
 StoredPokemon* storage_getParty(Generation gen);
 
-// Persist and retrieve trade mode
+// Bumped by every slot save/clear; lets callers cache data derived from slots
+uint32_t storage_getVersion();
+
+// Persist (write-behind) and retrieve trade mode
 void storage_setTradeMode(TradeMode mode);
 TradeMode storage_getTradeMode();
 
@@ -0,0 +1,125 @@
+#ifndef TRADE_CONTEXT_H
+#define TRADE_CONTEXT_H
+
+#include "config.h"
+#include "spsc_ring.h"
+#include <Arduino.h>
+#include <string.h>
+
+// =============================================================================
+// Trade Status — protocol state published by the main loop
+// =============================================================================
+
+struct TradeStatus {
+    int appState;                       // AppState: what the Game Boy is talking to
+    int connState;                      // ConnectionState enum value
+    int tcState;                        // TradeCentreState enum value
+    int gen;                            // Generation enum value
+    int tradePokemon;                   // GB's selection (-1 = none)
+
+    // Web-controlled settings as the loop currently applies them
+    int tradeMode;                      // TradeMode enum value
+    int offerSlot;                      // Which of our slots to offer
+    bool autoConfirm;
+    uint32_t holdTimeoutMs;             // Manual confirmation deadline (0 = no hold)
+    bool holdDefaultConfirm;            // Outcome when the deadline passes
+    bool holding;                       // Link held in TC_TRADE_CONFIRMATION now
+    bool capturing;                     // Sessions are being recorded
+    uint32_t lastCommandSeq;            // Newest command the loop has taken
+    uint32_t printedImages;             // Printer images since boot
+    uint32_t galleryVersion;            // Bumped when saved prints change
+
+    // Opponent party info (filled after party exchange)
+    uint32_t opponentVersion;           // Bumped whenever the fields below change
+    int opponentCount;
+    uint8_t opponentSpecies[PARTY_LENGTH];
+    uint8_t opponentLevels[PARTY_LENGTH];
+    uint8_t opponentNicknames[PARTY_LENGTH][NAME_LENGTH];
+};
+
+// =============================================================================
+// Trade Commands — web server -> main loop
+// =============================================================================
+
+enum TradeCommandType : uint8_t {
+    CMD_SET_OFFER,                      // arg = party slot
+    CMD_SET_AUTO,                       // arg = 0/1
+    CMD_SET_MODE,                       // arg = TradeMode
+    CMD_SET_HOLD,                       // arg = manual confirmation deadline, ms
+    CMD_SET_CAPTURE,                    // arg = 0/1, record sessions to /capture
+    CMD_SET_HOLD_DEFAULT,               // arg = 1 confirm / 0 decline at the deadline
+    CMD_MASTER_BENCH,                   // Clock a test pattern at every master rate
+    CMD_PERF_RESET,                     // Clear the perf counters between bytes
+    CMD_CONFIRM,                        // Held until the next trade confirmation
+    CMD_DECLINE
+};
+
+struct TradeCommand {
+    uint32_t seq;
+    uint32_t issuedUs;                  // micros() when posted
+    uint8_t type;                       // TradeCommandType
+    int32_t arg;
+};
+
+// =============================================================================
+// Trade Context — shared state between main loop and web server
+// =============================================================================
+
+struct TradeContext {
+    // Seqlock-published status: one writer (main loop), any number of readers.
+    // statusSeq is odd while a publish is in progress.
+    volatile uint32_t statusSeq;
+    TradeStatus status;
+
+    // Web UI control: the web server (AsyncTCP task) is the only producer,
+    // the main loop the only consumer
+    SpscRing<TradeCommand, COMMAND_RING_SIZE> commands;
+    uint32_t commandSeq;                // Producer owned
+    volatile uint32_t commandsDropped;  // Ring was full
+};
+
+// Writer side: copy a new status in. Main loop only.
+inline void tradeStatus_publish(TradeContext* ctx, const TradeStatus* s) {
+    ctx->statusSeq = ctx->statusSeq + 1;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&ctx->status, s, sizeof(TradeStatus));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ctx->statusSeq = ctx->statusSeq + 1;
+}
+
+// Reader side: consistent copy of the status; returns its version (bumped
+// once per publish). A reader that catches a publish in progress sleeps a
+// tick so the (lower-priority) loop task can finish it.
+inline uint32_t tradeStatus_read(const TradeContext* ctx, TradeStatus* out) {
+    for (;;) {
+        uint32_t seq = ctx->statusSeq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(seq & 1)) {
+            memcpy(out, (const void*)&ctx->status, sizeof(TradeStatus));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (ctx->statusSeq == seq) return seq >> 1;
+        }
+        vTaskDelay(1);
+    }
+}
+
+// Producer side: queue a command; returns its seq, or 0 if the ring is full
+inline uint32_t tradeCommand_post(TradeContext* ctx, TradeCommandType type, int32_t arg) {
+    TradeCommand cmd;
+    cmd.seq = ++ctx->commandSeq;
+    cmd.issuedUs = micros();
+    cmd.type = type;
+    cmd.arg = arg;
+    if (!ctx->commands.push(cmd)) {
+        ctx->commandsDropped = ctx->commandsDropped + 1;
+        return 0;
+    }
+    return cmd.seq;
+}
+
+// Version of the latest published status, without copying it
+inline uint32_t tradeStatus_version(const TradeContext* ctx) {
+    return ctx->statusSeq >> 1;
+}
+
+#endif // TRADE_CONTEXT_H
@@ -6,77 +6,289 @@
 // (from pokered home/serial.asm FixDataForLinkTransfer / ApplyPatchList)
 // =============================================================================
 
+// Patch list format:
+//   [3 bytes preamble: 0xFD 0xFD 0xFD]
+//   [part 1 offsets...] [0xFF terminator]
+//   [part 2 offsets...] [0xFF terminator]
+// Part 1 covers data[0..splitOffset-1], Part 2 covers data[splitOffset..].
+// Offsets are 1-indexed and relative to the start of their part.
+
+// SWAR: bit 7 set in each byte lane of w that equals 0xFE. Exact per lane
+// (no borrow propagation between lanes).
+static inline uint32_t noDataLanes(uint32_t w) {
+    uint32_t x = w ^ 0xFEFEFEFEu;                        // 0x00 where w == 0xFE
+    return ~(((x & 0x7F7F7F7Fu) + 0x7F7F7F7Fu) | x) & 0x80808080u;
+}
+
+void PatchEncoder::begin(uint8_t* list, uint16_t split) {
+    patchList = list;
+    splitOffset = split;
+    pos = 0;
+    inPart2 = false;
+
+    memset(patchList, 0, GEN1_PATCH_LIST_SIZE);
+    patchList[0] = SERIAL_PREAMBLE_BYTE;
+    patchList[1] = SERIAL_PREAMBLE_BYTE;
+    patchList[2] = SERIAL_PREAMBLE_BYTE;
+    patchIdx = 3;
+}
+
+void PatchEncoder::feed(uint8_t* data, uint16_t len) {
+    uint16_t i = 0;
+
+    while (i < len) {
+        uint16_t at = pos + i;
+
+        if (!inPart2 && at >= splitOffset) {
+            if (patchIdx < GEN1_PATCH_LIST_SIZE - 1) {
+                patchList[patchIdx++] = SERIAL_PATCH_TERM; // Part 1 terminator
+            }
+            inPart2 = true;
+        }
+
+        // Skip ahead a word at a time while no lane holds 0xFE
+        if (((uintptr_t)(data + i) & 3) == 0) {
+            while (len - i >= 4) {
+                uint32_t w;
+                memcpy(&w, __builtin_assume_aligned(data + i, 4), 4);  // One lw, no aliasing
+                uint32_t lanes = noDataLanes(w);
+                if (lanes) {
+                    // Little-endian: lowest set lane is the first 0xFE
+                    i += __builtin_ctz(lanes) >> 3;
+                    break;
+                }
+                // Don't let a word straddle the split; part 2 needs its terminator first
+                if (!inPart2 && pos + i + 4 > splitOffset) break;
+                i += 4;
+            }
+            if (i >= len) break;
+            at = pos + i;
+            if (!inPart2 && at >= splitOffset) continue;
+        }
+
+        if (data[i] == SERIAL_NO_DATA_BYTE) {
+            uint16_t limit = inPart2 ? GEN1_PATCH_LIST_SIZE - 1 : GEN1_PATCH_LIST_SIZE - 2;
+            if (patchIdx < limit) {
+                patchList[patchIdx++] = inPart2 ? (at - splitOffset) + 1 : at + 1;
+                data[i] = SERIAL_PATCH_TERM;   // Replace with 0xFF
+            }
+        }
+        i++;
+    }
+
+    pos += len;
+}
+
+void PatchEncoder::finish() {
+    if (!inPart2) {
+        if (patchIdx < GEN1_PATCH_LIST_SIZE - 1) {
+            patchList[patchIdx++] = SERIAL_PATCH_TERM; // Part 1 terminator
+        }
+        inPart2 = true;
+    }
+    if (patchIdx < GEN1_PATCH_LIST_SIZE) {
+        patchList[patchIdx] = SERIAL_PATCH_TERM;   // Part 2 terminator
+    }
+}
+
+void PatchDecoder::begin(uint8_t* dst, uint16_t len) {
+    data = dst;
+    dataLen = len;
+    baseOffset = 0;
+    inPart2 = false;
+    done = false;
+}
+
+void PatchDecoder::feed(uint8_t val) {
+    if (done) return;
+
+    if (val == SERIAL_PATCH_TERM) {
+        if (inPart2) {
+            done = true;
+            return;
+        }
+        inPart2 = true;
+        baseOffset = PATCH_DATA_SPLIT;
+        return;
+    }
+    if (val == 0 || val == SERIAL_PREAMBLE_BYTE || val == SERIAL_NO_DATA_BYTE) {
+        return; // Skip special bytes (and the preamble)
+    }
+
+    uint16_t offset = baseOffset + (val - 1); // 1-indexed back to 0-indexed
+    if (offset < dataLen) {
+        data[offset] = SERIAL_NO_DATA_BYTE;   // Restore 0xFE
+    }
+}
+
 void buildPatchList(uint8_t* data, uint16_t dataLen, uint8_t* patchList,
                     uint16_t splitOffset) {
-    // Patch list format:
-    //   [3 bytes preamble: 0xFD 0xFD 0xFD]
-    //   [part 1 offsets...] [0xFF terminator]
-    //   [part 2 offsets...] [0xFF terminator]
-    // Part 1 covers data[0..splitOffset-1], Part 2 covers data[splitOffset..]
+    PatchEncoder enc;
+    enc.begin(patchList, splitOffset);
+    enc.feed(data, dataLen);
+    enc.finish();
+}
 
-    memset(patchList, 0, GEN1_PATCH_LIST_SIZE);
+void applyPatchList(uint8_t* data, uint16_t dataLen, const uint8_t* patchList) {
+    PatchDecoder dec;
+    dec.begin(data, dataLen);
+    for (uint16_t i = 0; i < GEN1_PATCH_LIST_SIZE && !dec.done; i++) {
+        dec.feed(patchList[i]);
+    }
+}
 
-    // Preamble
+#if PATCH_SELFTEST
+// =============================================================================
+// Patch codec self-test — the word-scanning encoder and streaming decoder
+// against the original byte-at-a-time buildPatchList/applyPatchList
+// =============================================================================
+
+static void refBuildPatchList(uint8_t* data, uint16_t dataLen, uint8_t* patchList,
+                              uint16_t splitOffset) {
+    memset(patchList, 0, GEN1_PATCH_LIST_SIZE);
     patchList[0] = SERIAL_PREAMBLE_BYTE;
     patchList[1] = SERIAL_PREAMBLE_BYTE;
     patchList[2] = SERIAL_PREAMBLE_BYTE;
 
     uint16_t patchIdx = 3;
-
-    // Part 1: scan data[0..splitOffset-1]
     uint16_t end1 = (splitOffset < dataLen) ? splitOffset : dataLen;
     for (uint16_t i = 0; i < end1 && patchIdx < GEN1_PATCH_LIST_SIZE - 2; i++) {
         if (data[i] == SERIAL_NO_DATA_BYTE) {
-            patchList[patchIdx++] = i + 1; // Offset is 1-indexed
-            data[i] = SERIAL_PATCH_TERM;   // Replace with 0xFF
+            patchList[patchIdx++] = i + 1;
+            data[i] = SERIAL_PATCH_TERM;
         }
     }
     if (patchIdx < GEN1_PATCH_LIST_SIZE - 1) {
-        patchList[patchIdx++] = SERIAL_PATCH_TERM; // Part 1 terminator
+        patchList[patchIdx++] = SERIAL_PATCH_TERM;
     }
-
-    // Part 2: scan data[splitOffset..dataLen-1]
     for (uint16_t i = splitOffset; i < dataLen && patchIdx < GEN1_PATCH_LIST_SIZE - 1; i++) {
         if (data[i] == SERIAL_NO_DATA_BYTE) {
-            patchList[patchIdx++] = (i - splitOffset) + 1; // Relative, 1-indexed
+            patchList[patchIdx++] = (i - splitOffset) + 1;
             data[i] = SERIAL_PATCH_TERM;
         }
     }
     if (patchIdx < GEN1_PATCH_LIST_SIZE) {
-        patchList[patchIdx] = SERIAL_PATCH_TERM; // Part 2 terminator
+        patchList[patchIdx] = SERIAL_PATCH_TERM;
     }
 }
 
-void applyPatchList(uint8_t* data, uint16_t dataLen, const uint8_t* patchList) {
-    // Skip preamble bytes at start of patch list
+static void refApplyPatchList(uint8_t* data, uint16_t dataLen, const uint8_t* patchList) {
     uint16_t patchIdx = 0;
-    while (patchIdx < GEN1_PATCH_LIST_SIZE &&
-           patchList[patchIdx] == SERIAL_PREAMBLE_BYTE) {
+    while (patchIdx < GEN1_PATCH_LIST_SIZE && patchList[patchIdx] == SERIAL_PREAMBLE_BYTE) {
         patchIdx++;
     }
-
     bool inPart2 = false;
     uint16_t baseOffset = 0;
-
     while (patchIdx < GEN1_PATCH_LIST_SIZE) {
         uint8_t val = patchList[patchIdx++];
-
         if (val == SERIAL_PATCH_TERM) {
-            if (inPart2) break; // Done
+            if (inPart2) break;
             inPart2 = true;
             baseOffset = PATCH_DATA_SPLIT;
             continue;
         }
-        if (val == 0 || val == SERIAL_PREAMBLE_BYTE || val == SERIAL_NO_DATA_BYTE) {
-            continue; // Skip special bytes
+        if (val == 0 || val == SERIAL_PREAMBLE_BYTE || val == SERIAL_NO_DATA_BYTE) continue;
+        uint16_t offset = baseOffset + (val - 1);
+        if (offset < dataLen) data[offset] = SERIAL_NO_DATA_BYTE;
+    }
+}
+
+static uint32_t testRng;
+
+static uint32_t nextRandom() {
+    testRng ^= testRng << 13;
+    testRng ^= testRng >> 17;
+    testRng ^= testRng << 5;
+    return testRng;
+}
+
+// One block: encode with both, compare list and patched data, then decode
+// both ways and compare against the original. Returns true when all agree.
+static bool checkBlock(const uint8_t* orig, uint16_t len, uint8_t align,
+                       PatchSelfTest* out) {
+    static uint8_t refData[MAX_PARTY_BLOCK_SIZE];
+    static uint8_t newBuf[MAX_PARTY_BLOCK_SIZE + 4];
+    static uint8_t chunkData[MAX_PARTY_BLOCK_SIZE];
+    static uint8_t refList[GEN1_PATCH_LIST_SIZE];
+    static uint8_t newList[GEN1_PATCH_LIST_SIZE];
+    static uint8_t chunkList[GEN1_PATCH_LIST_SIZE];
+    uint8_t* newData = newBuf + align;          // Exercise every word alignment
+
+    memcpy(refData, orig, len);
+    memcpy(newData, orig, len);
+    memcpy(chunkData, orig, len);
+
+    uint32_t t = micros();
+    refBuildPatchList(refData, len, refList, PATCH_DATA_SPLIT);
+    out->refUs += micros() - t;
+
+    t = micros();
+    buildPatchList(newData, len, newList, PATCH_DATA_SPLIT);
+    out->newUs += micros() - t;
+
+    // Fed in random chunks, as the prepared party and the sim do
+    PatchEncoder enc;
+    enc.begin(chunkList, PATCH_DATA_SPLIT);
+    for (uint16_t at = 0; at < len; ) {
+        uint16_t n = 1 + nextRandom() % 64;
+        if (n > len - at) n = len - at;
+        enc.feed(chunkData + at, n);
+        at += n;
+    }
+    enc.finish();
+
+    if (memcmp(refList, newList, GEN1_PATCH_LIST_SIZE) != 0) return false;
+    if (memcmp(refList, chunkList, GEN1_PATCH_LIST_SIZE) != 0) return false;
+    if (memcmp(refData, newData, len) != 0) return false;
+    if (memcmp(refData, chunkData, len) != 0) return false;
+
+    // The list only holds 196 offsets; a block with more 0xFE can't round-trip
+    int noData = 0;
+    for (uint16_t i = 0; i < len; i++) noData += (orig[i] == SERIAL_NO_DATA_BYTE);
+    bool fits = noData <= GEN1_PATCH_LIST_SIZE - 5;
+
+    refApplyPatchList(refData, len, refList);
+    PatchDecoder dec;
+    dec.begin(newData, len);
+    for (uint16_t i = 0; i < GEN1_PATCH_LIST_SIZE && !dec.done; i++) {
+        dec.feed(newList[i]);
+    }
+    if (memcmp(refData, newData, len) != 0) return false;
+    return !fits || memcmp(orig, newData, len) == 0;
+}
+
+void patch_selfTest(uint32_t seed, int rounds, PatchSelfTest* out) {
+    static uint8_t block[MAX_PARTY_BLOCK_SIZE];
+    memset(out, 0, sizeof(*out));
+    testRng = seed ? seed : 1;
+
+    for (int r = 0; r < rounds; r++) {
+        // Lengths: both real party blocks, and every length around the split
+        uint16_t len;
+        switch (r % 4) {
+            case 0:  len = GEN1_PARTY_BLOCK_SIZE - GEN1_PREAMBLE_SIZE; break;
+            case 1:  len = GEN2_PARTY_BLOCK_SIZE - GEN2_PREAMBLE_SIZE; break;
+            case 2:  len = PATCH_DATA_SPLIT - 4 + (r / 4) % 9; break;
+            default: len = 1 + nextRandom() % MAX_PARTY_BLOCK_SIZE; break;
         }
 
-        uint16_t offset = baseOffset + (val - 1); // 1-indexed back to 0-indexed
-        if (offset < dataLen) {
-            data[offset] = SERIAL_NO_DATA_BYTE; // Restore 0xFE
+        // 0xFE density from none to nearly all, plus 0xFE runs across the split
+        uint32_t density = (r / 4) % 8;
+        for (uint16_t i = 0; i < len; i++) {
+            uint32_t v = nextRandom();
+            block[i] = ((v >> 8) % 8 < density) ? SERIAL_NO_DATA_BYTE : (uint8_t)v;
         }
+        if (r % 3 == 0) {
+            for (int i = PATCH_DATA_SPLIT - 4; i < PATCH_DATA_SPLIT + 4 && i < len; i++) {
+                block[i] = SERIAL_NO_DATA_BYTE;
+            }
+        }
+
+        out->cases++;
+        if (!checkBlock(block, len, r & 3, out)) out->failures++;
     }
 }
+#endif
 
 // =============================================================================
 // Gen 1 Species Name Table
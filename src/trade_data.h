@@ -138,6 +138,49 @@ void buildPatchList(uint8_t* data, uint16_t dataLen, uint8_t* patchList,
 // Apply a received patch list: restore 0xFE bytes at recorded offsets.
 void applyPatchList(uint8_t* data, uint16_t dataLen, const uint8_t* patchList);
 
+// Streaming encoder: feed the outgoing data in order, in chunks of any size.
+// Each chunk is patched in place (0xFE -> 0xFF) and its offsets appended to
+// the patch list as it goes. Same output as buildPatchList().
+struct PatchEncoder {
+    uint8_t* patchList;
+    uint16_t splitOffset;
+    uint16_t pos;           // Stream offset of the next byte fed
+    uint16_t patchIdx;
+    bool inPart2;
+
+    void begin(uint8_t* list, uint16_t split);
+    void feed(uint8_t* data, uint16_t len);
+    void finish();
+};
+
+// Streaming decoder: feed received patch list bytes as they arrive; each
+// offset restores its 0xFE in the data immediately. Same result as
+// applyPatchList() over the complete list.
+struct PatchDecoder {
+    uint8_t* data;
+    uint16_t dataLen;
+    uint16_t baseOffset;
+    bool inPart2;
+    bool done;
+
+    void begin(uint8_t* dst, uint16_t len);
+    void feed(uint8_t val);
+};
+
+#if PATCH_SELFTEST
+// Round-trips random blocks (both party sizes, every length around the split,
+// 0xFE density up to nearly all) through PatchEncoder/PatchDecoder and the
+// original byte-at-a-time codec, and times both encoders.
+struct PatchSelfTest {
+    uint32_t cases;
+    uint32_t failures;      // Lists, patched data or restored data differed
+    uint32_t refUs;         // Total encode time, byte-at-a-time
+    uint32_t newUs;         // ... buildPatchList (PatchEncoder, one feed)
+};
+
+void patch_selfTest(uint32_t seed, int rounds, PatchSelfTest* out);
+#endif
+
 // =============================================================================
 // Pokemon name tables (species index -> display name)
 // =============================================================================
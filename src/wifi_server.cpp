@@ -1,19 +1,43 @@
 #include "wifi_server.h"
 #include "storage.h"
 #include "trade_data.h"
+#include "perf.h"
+#include "box_store.h"
+#include "journal.h"
+#include "capture.h"
+#include "printer.h"
+#include "png_stream.h"
+#include "link_master.h"
+#include "framing.h"
+#include "gallery.h"
+#include "link_cable.h"
+#include "json_writer.h"
+#include "debug_log.h"
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <LittleFS.h>
-#include <stdarg.h>
 
 // =============================================================================
 // WiFi + Web Server Implementation
 // =============================================================================
 
 static AsyncWebServer server(80);
-static AsyncEventSource events("/events");
+static AsyncEventSource events("/events");        // Debug log + SPI trace
+static AsyncEventSource stateEvents("/state");    // Live dashboard state
 static TradeContext* ctx = nullptr;
 
+// Printed image PNG encoders, one per download in flight (AsyncTCP task only)
+static PngStream pngStreams[PNG_STREAMS];
+static File pngFiles[PNG_STREAMS];              // Source of a gallery print
+static bool pngBusy[PNG_STREAMS];
+static int pngActive = 0;
+static int pngPeak = 0;
+
+// AppState names (must match enum order in config.h)
+static const char* APP_NAMES[] = {
+    "idle", "trade", "printer"
+};
+
 // Connection state names (must match enum order in main.cpp)
 static const char* CONN_NAMES[] = {
     "not_connected", "connected", "trade_centre", "colosseum"
@@ -56,111 +80,330 @@ static void gbTextToAscii(const uint8_t* src, char* dst, int maxLen) {
     dst[maxLen - 1] = '\0';
 }
 
+// Helper: encode ASCII to Game Boy text (inverse of gbTextToAscii, for searches)
+static void asciiToGbText(const char* src, uint8_t* dst, int maxLen) {
+    int i = 0;
+    for (; i < maxLen - 1 && src[i]; i++) {
+        char c = src[i];
+        if (c >= 'A' && c <= 'Z') dst[i] = 0x80 + (c - 'A');
+        else if (c >= 'a' && c <= 'z') dst[i] = 0xA0 + (c - 'a');
+        else if (c == '\'') dst[i] = 0xE8;
+        else if (c == '-') dst[i] = 0xE3;
+        else if (c == '.') dst[i] = 0xF2;
+        else dst[i] = 0x7F;
+    }
+    for (; i < maxLen; i++) dst[i] = 0x50;  // Terminator + fill
+}
+
+// Helper: integer field from a small JSON request body, or def if absent
+static int bodyInt(const String& body, const char* key, int def) {
+    char pat[24];
+    int patLen = snprintf(pat, sizeof(pat), "\"%s\":", key);
+    int idx = body.indexOf(pat);
+    if (idx < 0) return def;
+    return body.substring(idx + patLen).toInt();
+}
+
+static int queryInt(AsyncWebServerRequest* request, const char* name, int def) {
+    if (!request->hasParam(name)) return def;
+    return request->getParam(name)->value().toInt();
+}
+
+// Record id from the URL path. False unless it's all digits and <= maxId, so
+// large values can't wrap onto a small id when narrowed.
+static bool pathId(AsyncWebServerRequest* request, uint32_t maxId, uint32_t* out) {
+    const char* arg = request->pathArg(0).c_str();
+    if (*arg == 0 || strlen(arg) > 10) return false;
+    uint64_t v = 0;
+    for (; *arg; arg++) {
+        if (*arg < '0' || *arg > '9') return false;
+        v = v * 10 + (*arg - '0');
+    }
+    if (v > maxId) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
 // =============================================================================
 // Debug Logging
 // =============================================================================
 
-void debug_logf(const char* fmt, ...) {
-    char buf[256];
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
-    va_end(args);
-    Serial.print(buf);
-    events.send(buf, "log", millis());
+void wifi_sendLog(const char* text, uint32_t id) {
+    events.send(text, "log", id);
 }
 
-// SPI batch buffer — raw bytes, formatted on flush
-#define SPI_BATCH_MAX 256
-static uint8_t spiBatchSend[SPI_BATCH_MAX];
-static uint8_t spiBatchRecv[SPI_BATCH_MAX];
-static int spiBatchLen = 0;
+// =============================================================================
+// SPI Trace
+// The loop fills fixed batches of timestamped exchanges and hands each full
+// batch to the debug task, which RLE-encodes it into one WebSocket binary
+// frame on /trace. A batch still owned by the debug task is never waited
+// for: the exchanges are counted as dropped instead, and every frame carries
+// the sequence number of its first exchange so the page can see the gap.
+//
+// Frame (little-endian):
+//   u8 format (1), u8 reserved, u16 pairs, u32 firstSeq, u32 firstUs,
+//   u32 droppedTotal, then items:
+//   0x00-0x7F  n+1 literal pairs, each: sent, recv, varint dtUs
+//   0x80-0xFF  n+2 identical pairs: sent, recv, varint dtUs (per pair)
+// dtUs is relative to the previous pair (the first pair's is 0).
+// =============================================================================
+
+#define TRACE_FORMAT      1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_MAX_RUN     129
+#define TRACE_MAX_LITERAL 128
+
+struct TraceBatch {
+    volatile bool ready;                // Owned by the debug task while set
+    uint16_t count;
+    uint32_t firstSeq;
+    uint32_t us[TRACE_BATCH_PAIRS];
+    uint8_t sent[TRACE_BATCH_PAIRS];
+    uint8_t recv[TRACE_BATCH_PAIRS];
+};
 
-static const char HEX_CHARS[] = "0123456789ABCDEF";
+static AsyncWebSocket traceWs("/trace");
+static TraceBatch traceBatches[TRACE_BATCHES];
+static volatile bool traceListening = false;
+static int fillIdx = 0;                 // Loop task
+static int drainIdx = 0;                // Debug task
+static uint32_t traceSeq = 0;           // Exchanges seen since boot
+static volatile uint32_t traceDropped = 0;
+
+// Worst case: every pair a 5-byte-varint literal, plus a control byte per 128
+static uint8_t traceFrame[TRACE_HEADER_SIZE + TRACE_BATCH_PAIRS * 7 + TRACE_BATCH_PAIRS / TRACE_MAX_LITERAL + 1];
+
+static void publishBatch(TraceBatch* b) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    b->ready = true;
+    fillIdx = (fillIdx + 1) % TRACE_BATCHES;
+}
 
 void debug_spi(uint8_t sent, uint8_t recv) {
-    if (spiBatchLen < SPI_BATCH_MAX) {
-        spiBatchSend[spiBatchLen] = sent;
-        spiBatchRecv[spiBatchLen] = recv;
-        spiBatchLen++;
+    uint32_t seq = traceSeq++;
+    if (!traceListening) return;
+
+    TraceBatch* b = &traceBatches[fillIdx];
+    if (b->ready) {
+        traceDropped++;                 // Debug task is behind
+        return;
     }
-    if (spiBatchLen >= SPI_BATCH_MAX) debug_spi_flush();
+    if (b->count == 0) b->firstSeq = seq;
+    b->us[b->count] = micros();
+    b->sent[b->count] = sent;
+    b->recv[b->count] = recv;
+    if (++b->count == TRACE_BATCH_PAIRS) publishBatch(b);
 }
 
 void debug_spi_flush() {
-    if (spiBatchLen == 0) return;
-    int len = spiBatchLen;
-    spiBatchLen = 0;
+    TraceBatch* b = &traceBatches[fillIdx];
+    if (!b->ready && b->count > 0) publishBatch(b);
+}
+
+static uint8_t* putU16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t* putU32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint8_t* putVarint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static size_t encodeBatch(const TraceBatch* b, uint32_t dropped, uint8_t* out) {
+    uint8_t* p = out;
+    *p++ = TRACE_FORMAT;
+    *p++ = 0;
+    p = putU16(p, b->count);
+    p = putU32(p, b->firstSeq);
+    p = putU32(p, b->us[0]);
+    p = putU32(p, dropped);
+
+    uint32_t prevUs = b->us[0];         // Timestamp as the decoder will see it
+    uint8_t* literalCtrl = nullptr;
+    int i = 0;
+    while (i < b->count) {
+        int run = 1;
+        while (i + run < b->count && run < TRACE_MAX_RUN &&
+               b->sent[i + run] == b->sent[i] && b->recv[i + run] == b->recv[i]) {
+            run++;
+        }
+
+        if (run >= 2) {
+            // Mean interval over the run; the decoder spaces the pairs evenly
+            uint32_t dt = (b->us[i + run - 1] - prevUs) / run;
+            *p++ = 0x80 | (run - 2);
+            *p++ = b->sent[i];
+            *p++ = b->recv[i];
+            p = putVarint(p, dt);
+            prevUs += dt * run;
+            literalCtrl = nullptr;
+            i += run;
+            continue;
+        }
+
+        if (!literalCtrl || *literalCtrl == TRACE_MAX_LITERAL - 1) {
+            literalCtrl = p;
+            *p++ = 0;
+        } else {
+            (*literalCtrl)++;
+        }
+        *p++ = b->sent[i];
+        *p++ = b->recv[i];
+        p = putVarint(p, b->us[i] - prevUs);
+        prevUs = b->us[i];
+        i++;
+    }
+    return p - out;
+}
+
+bool debug_spi_drain() {
+    traceListening = traceWs.count() > 0;
+
+    TraceBatch* b = &traceBatches[drainIdx];
+    if (!b->ready) return false;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
 
-    // Format: "XX:YY\n" per pair (6 chars each)
-    static char buf[SPI_BATCH_MAX * 6 + 1];
-    int pos = 0;
-    for (int i = 0; i < len; i++) {
-        buf[pos++] = HEX_CHARS[spiBatchSend[i] >> 4];
-        buf[pos++] = HEX_CHARS[spiBatchSend[i] & 0xF];
-        buf[pos++] = ':';
-        buf[pos++] = HEX_CHARS[spiBatchRecv[i] >> 4];
-        buf[pos++] = HEX_CHARS[spiBatchRecv[i] & 0xF];
-        buf[pos++] = '\n';
+    if (traceWs.count() > 0) {
+        size_t len = encodeBatch(b, traceDropped, traceFrame);
+        if (traceWs.availableForWriteAll()) {
+            traceWs.binaryAll(traceFrame, len);
+        } else {
+            traceDropped += b->count;   // A client's send queue is full
+        }
     }
-    buf[pos] = '\0';
-    events.send(buf, "spi", millis());
+
+    b->count = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    b->ready = false;
+    drainIdx = (drainIdx + 1) % TRACE_BATCHES;
+    return true;
+}
+
+static void onTraceEvent(AsyncWebSocket* ws, AsyncWebSocketClient* client,
+                         AwsEventType type, void* arg, uint8_t* data, size_t len) {
+    if (type == WS_EVT_CONNECT) ws->cleanupClients();
 }
 
 // =============================================================================
-// REST API Handlers
+// JSON Responses
+// Handlers run one at a time in the AsyncTCP task. Each writes its body into a
+// free JSON_BODIES buffer, which the response then reads from in place until
+// the client disconnects: no String copy, no heap. With every buffer still
+// out, the body goes to the shared responseBuf and send() copies it. Live
+// state pushes come from the loop task and have their own buffer.
 // =============================================================================
 
-static void handleStatus(AsyncWebServerRequest* request) {
-    char json[512];
-    snprintf(json, sizeof(json),
-        "{\"mode\":\"%s\",\"conn\":\"%s\",\"tc\":\"%s\",\"gen\":\"%s\","
-        "\"tradePokemon\":%d,\"offerSlot\":%d,\"autoConfirm\":%s,"
-        "\"opponentCount\":%d}",
-        ctx->tradeMode == TRADE_MODE_CLONE ? "clone" : "storage",
-        CONN_NAMES[ctx->connState],
-        TC_NAMES[ctx->tcState],
-        genName(ctx->gen),
-        ctx->tradePokemon,
-        ctx->offerSlot,
-        ctx->autoConfirm ? "true" : "false",
-        ctx->opponentCount);
-    request->send(200, "application/json", json);
+#define RESPONSE_BUF_SIZE 8192
+#define PUSH_BUF_SIZE     2048
+
+static char responseBuf[RESPONSE_BUF_SIZE];
+static char pushBuf[PUSH_BUF_SIZE];
+
+static char jsonBodies[JSON_BODIES][RESPONSE_BUF_SIZE];
+static bool jsonBusy[JSON_BODIES];
+static int jsonActive = 0;
+static int jsonPeak = 0;
+static uint32_t jsonInPlace = 0;
+static uint32_t jsonCopied = 0;
+static uint32_t jsonBytes = 0;
+
+// Point w at a free body buffer. It stays free until sendJson() claims it,
+// and nothing else runs in between, so a handler that bails out early with
+// its own send() leaks nothing.
+static void jsonBegin(JsonWriter& w) {
+    for (int i = 0; i < JSON_BODIES; i++) {
+        if (!jsonBusy[i]) {
+            w.begin(jsonBodies[i], RESPONSE_BUF_SIZE);
+            return;
+        }
+    }
+    w.begin(responseBuf, sizeof(responseBuf));
 }
 
-static void handleSetMode(AsyncWebServerRequest* request, uint8_t* data, size_t len,
-                           size_t index, size_t total) {
-    String body = String((char*)data, len);
-    TradeMode newMode;
-    if (body.indexOf("\"storage\"") >= 0) {
-        newMode = TRADE_MODE_STORAGE;
-    } else {
-        newMode = TRADE_MODE_CLONE;
+// Serve body[0..len) without copying it; release() runs once the client is gone
+static AsyncWebServerResponse* beginInPlace(AsyncWebServerRequest* request, const char* body,
+                                            size_t len, std::function<void()> release) {
+    request->onDisconnect(release);
+    return request->beginResponse("application/json", len,
+        [body, len](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+            size_t n = len - index;
+            if (n > maxLen) n = maxLen;
+            memcpy(buf, body + index, n);
+            return n;
+        });
+}
+
+static void sendJson(AsyncWebServerRequest* request, const JsonWriter& w) {
+    if (!w.ok()) {
+        request->send(500, "application/json", "{\"error\":\"response too large\"}");
+        return;
     }
-    ctx->tradeMode = newMode;
-    storage_setTradeMode(newMode);
-    request->send(200, "application/json", "{\"ok\":true}");
+    jsonBytes += w.length();
+
+    int slot = 0;
+    while (slot < JSON_BODIES && w.c_str() != jsonBodies[slot]) slot++;
+    if (slot == JSON_BODIES) {
+        jsonCopied++;
+        request->send(200, "application/json", w.c_str());
+        return;
+    }
+
+    jsonBusy[slot] = true;
+    if (++jsonActive > jsonPeak) jsonPeak = jsonActive;
+    jsonInPlace++;
+    request->send(beginInPlace(request, w.c_str(), w.length(), [slot]() {
+        jsonBusy[slot] = false;
+        jsonActive--;
+    }));
 }
 
-static void handleGetPokemon(AsyncWebServerRequest* request) {
-    String genParam = request->pathArg(0);
-    Generation g = (genParam == "gen1" || genParam == "1") ? GEN_1 : GEN_2;
-    StoredPokemon* party = storage_getParty(g);
+static void writeStatus(JsonWriter& w, const TradeStatus& s, uint32_t version) {
+    w.beginObject();
+    w.fieldStr("mode", s.tradeMode == TRADE_MODE_CLONE ? "clone" : "storage");
+    w.fieldStr("app", APP_NAMES[s.appState]);
+    w.fieldStr("conn", CONN_NAMES[s.connState]);
+    w.fieldStr("tc", TC_NAMES[s.tcState]);
+    w.fieldStr("gen", genName(s.gen));
+    w.fieldInt("tradePokemon", s.tradePokemon);
+    w.fieldInt("offerSlot", s.offerSlot);
+    w.fieldBool("autoConfirm", s.autoConfirm);
+    w.fieldBool("holding", s.holding);
+    w.fieldUint("holdTimeoutMs", s.holdTimeoutMs);
+    w.fieldStr("holdDefault", s.holdDefaultConfirm ? "confirm" : "decline");
+    w.fieldBool("capturing", s.capturing);
+    w.fieldUint("printedImages", s.printedImages);
+    w.fieldUint("galleryVersion", s.galleryVersion);
+    w.fieldInt("opponentCount", s.opponentCount);
+    w.fieldUint("version", version);
+    w.fieldUint("commandSeq", s.lastCommandSeq);
+    w.endObject();
+}
 
-    String json = "[";
+static void writeParty(JsonWriter& w, Generation g) {
+    StoredPokemon* party = storage_getParty(g);
+    w.beginArray();
     for (int i = 0; i < PARTY_LENGTH; i++) {
-        if (i > 0) json += ",";
-        json += "{\"slot\":";
-        json += i;
-        json += ",\"occupied\":";
-        json += party[i].occupied ? "true" : "false";
+        w.beginObject();
+        w.fieldInt("slot", i);
+        w.fieldBool("occupied", party[i].occupied);
 
         if (party[i].occupied) {
-            json += ",\"species\":";
-            json += party[i].speciesIndex;
-            json += ",\"speciesName\":\"";
-            json += speciesName(g, party[i].speciesIndex);
-            json += "\"";
+            w.fieldInt("species", party[i].speciesIndex);
+            w.fieldStr("speciesName", speciesName(g, party[i].speciesIndex));
 
             int level = 0;
             if (g == GEN_1) {
@@ -170,21 +413,158 @@ static void handleGetPokemon(AsyncWebServerRequest* request) {
                 Gen2PartyMon* mon = (Gen2PartyMon*)party[i].monData;
                 level = mon->level;
             }
-            json += ",\"level\":";
-            json += level;
+            w.fieldInt("level", level);
 
             char nick[NAME_LENGTH + 1];
             gbTextToAscii(party[i].nickname, nick, NAME_LENGTH);
-            json += ",\"nickname\":\"";
-            json += nick;
-            json += "\"";
+            w.fieldStr("nickname", nick);
+        }
+        w.endObject();
+    }
+    w.endArray();
+}
+
+static void writeOpponent(JsonWriter& w, const TradeStatus& s) {
+    int count = s.opponentCount;
+    int g = s.gen;
+    w.beginArray();
+    for (int i = 0; i < count && i < PARTY_LENGTH; i++) {
+        w.beginObject();
+        w.fieldInt("slot", i);
+        w.fieldInt("species", s.opponentSpecies[i]);
+        w.fieldStr("speciesName", speciesName(g, s.opponentSpecies[i]));
+        w.fieldInt("level", s.opponentLevels[i]);
+
+        char nick[NAME_LENGTH + 1];
+        gbTextToAscii(s.opponentNicknames[i], nick, NAME_LENGTH);
+        w.fieldStr("nickname", nick);
+        w.endObject();
+    }
+    w.endArray();
+}
+
+// =============================================================================
+// Response Cache
+// Party and opponent lists only change on a trade or a delete, so each is
+// serialized once per source version and the same body is handed to every
+// client. The ETag is that version plus a per-boot tag (versions restart at
+// zero), letting browsers revalidate with If-None-Match for a bodiless 304.
+// =============================================================================
+
+#define CACHE_BODY_SIZE 1024
+
+enum CacheSlot { CACHE_GEN1, CACHE_GEN2, CACHE_OPPONENT, CACHE_SLOTS };
+
+struct CachedResponse {
+    bool valid;
+    uint32_t version;                   // Source version the body was built from
+    uint8_t readers;                    // Responses still sending body
+    uint16_t length;
+    char etag[24];
+    char body[CACHE_BODY_SIZE];
+};
+
+static CachedResponse responseCache[CACHE_SLOTS];   // AsyncTCP task only
+static uint32_t bootTag = 0;
+static uint32_t cacheHits = 0;
+static uint32_t cacheMisses = 0;
+
+// Reply from the cache, building the body first if it is stale. The version
+// is read by the caller before the build, so a change racing the build only
+// costs one extra rebuild on the next request. The body is served in place,
+// so it is never rebuilt under a response still sending it; that request
+// gets a one-off body instead.
+template <typename Fn>
+static void sendCached(AsyncWebServerRequest* request, CacheSlot slot, uint32_t version, Fn write) {
+    CachedResponse* c = &responseCache[slot];
+    if (!c->valid || c->version != version) {
+        JsonWriter w;
+        if (c->readers > 0) {
+            jsonBegin(w);
+            write(w);
+            sendJson(request, w);
+            return;
         }
-        json += "}";
+        w.begin(c->body, sizeof(c->body));
+        write(w);
+        if (!w.ok()) {
+            c->valid = false;
+            sendJson(request, w);
+            return;
+        }
+        c->valid = true;
+        c->version = version;
+        c->length = w.length();
+        snprintf(c->etag, sizeof(c->etag), "\"%08x-%d-%u\"",
+                 (unsigned)bootTag, (int)slot, (unsigned)version);
+        cacheMisses++;
+    } else {
+        cacheHits++;
+    }
+
+    AsyncWebServerResponse* response;
+    if (request->hasHeader("If-None-Match") &&
+        request->getHeader("If-None-Match")->value() == c->etag) {
+        response = request->beginResponse(304);
+    } else {
+        c->readers++;
+        response = beginInPlace(request, c->body, c->length, [c]() { c->readers--; });
+    }
+    response->addHeader("ETag", c->etag);
+    response->addHeader("Cache-Control", "no-cache");   // Always revalidate
+    request->send(response);
+}
+
+// =============================================================================
+// REST API Handlers
+// =============================================================================
+
+static void handleStatus(AsyncWebServerRequest* request) {
+    TradeStatus s;
+    uint32_t version = tradeStatus_read(ctx, &s);
+
+    JsonWriter w;
+    jsonBegin(w);
+    writeStatus(w, s, version);
+    sendJson(request, w);
+}
+
+// Queue a command for the main loop and reply with its seq; the loop applies
+// it between link bytes, and /api/status reports the newest seq it has taken
+static void postCommand(AsyncWebServerRequest* request, TradeCommandType type, int32_t arg) {
+    uint32_t seq = tradeCommand_post(ctx, type, arg);
+    link_wake();
+    if (seq == 0) {
+        request->send(503, "application/json", "{\"error\":\"command queue full\"}");
+        return;
+    }
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldBool("ok", true);
+    w.fieldUint("seq", seq);
+    w.endObject();
+    sendJson(request, w);
+}
+
+static void handleSetMode(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                           size_t index, size_t total) {
+    String body = String((char*)data, len);
+    TradeMode newMode;
+    if (body.indexOf("\"storage\"") >= 0) {
+        newMode = TRADE_MODE_STORAGE;
+    } else {
+        newMode = TRADE_MODE_CLONE;
     }
-    json += "]";
-    request->send(200, "application/json", json);
+    postCommand(request, CMD_SET_MODE, newMode);
 }
 
+static void handleGetPokemon(AsyncWebServerRequest* request) {
+    String genParam = request->pathArg(0);
+    Generation g = (genParam == "gen1" || genParam == "1") ? GEN_1 : GEN_2;
+    sendCached(request, g == GEN_1 ? CACHE_GEN1 : CACHE_GEN2, storage_getVersion(),
+               [&](JsonWriter& w) { writeParty(w, g); });
+}
 static void handleDeletePokemon(AsyncWebServerRequest* request) {
     String genParam = request->pathArg(0);
     String slotParam = request->pathArg(1);
@@ -203,60 +583,772 @@ static void handleDeletePokemon(AsyncWebServerRequest* request) {
 static void handleTradeOffer(AsyncWebServerRequest* request, uint8_t* data, size_t len,
                               size_t index, size_t total) {
     String body = String((char*)data, len);
-    int idx = body.indexOf("\"slot\":");
-    if (idx >= 0) {
-        int slot = body.substring(idx + 7).toInt();
-        if (slot >= 0 && slot < PARTY_LENGTH) {
-            ctx->offerSlot = slot;
-        }
+    int slot = bodyInt(body, "slot", -1);
+    if (slot < 0 || slot >= PARTY_LENGTH) {
+        request->send(400, "application/json", "{\"error\":\"invalid slot\"}");
+        return;
     }
-    request->send(200, "application/json", "{\"ok\":true}");
+    postCommand(request, CMD_SET_OFFER, slot);
 }
 
 static void handleTradeConfirm(AsyncWebServerRequest* request, uint8_t* data, size_t len,
                                 size_t index, size_t total) {
-    ctx->confirmRequested = true;
-    ctx->declineRequested = false;
-    request->send(200, "application/json", "{\"ok\":true}");
+    postCommand(request, CMD_CONFIRM, 0);
 }
 
 static void handleTradeDecline(AsyncWebServerRequest* request, uint8_t* data, size_t len,
                                 size_t index, size_t total) {
-    ctx->declineRequested = true;
-    ctx->confirmRequested = false;
-    request->send(200, "application/json", "{\"ok\":true}");
+    postCommand(request, CMD_DECLINE, 0);
 }
 
 static void handleTradeAuto(AsyncWebServerRequest* request, uint8_t* data, size_t len,
                              size_t index, size_t total) {
     String body = String((char*)data, len);
-    ctx->autoConfirm = (body.indexOf("true") >= 0);
-    request->send(200, "application/json", "{\"ok\":true}");
+    postCommand(request, CMD_SET_AUTO, body.indexOf("true") >= 0);
+}
+
+// Manual confirmation hold: {"timeoutMs":30000,"default":"decline"}
+static void handleTradeHold(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                            size_t index, size_t total) {
+    String body = String((char*)data, len);
+    bool hasDefault = body.indexOf("\"default\"") >= 0;
+    bool hasTimeout = body.indexOf("\"timeoutMs\"") >= 0;
+    if (!hasDefault && !hasTimeout) {
+        request->send(400, "application/json", "{\"error\":\"timeoutMs or default required\"}");
+        return;
+    }
+    int confirm = body.indexOf("\"confirm\"") >= 0;
+
+    // Either field alone leaves the other setting as it was
+    if (!hasTimeout) {
+        postCommand(request, CMD_SET_HOLD_DEFAULT, confirm);
+        return;
+    }
+    if (hasDefault && tradeCommand_post(ctx, CMD_SET_HOLD_DEFAULT, confirm) == 0) {
+        request->send(503, "application/json", "{\"error\":\"command queue full\"}");
+        return;
+    }
+    postCommand(request, CMD_SET_HOLD, bodyInt(body, "timeoutMs", TRADE_HOLD_MS));
 }
 
 static void handleGetOpponent(AsyncWebServerRequest* request) {
-    int count = ctx->opponentCount;
-    int g = ctx->gen;
-    String json = "[";
-    for (int i = 0; i < count && i < PARTY_LENGTH; i++) {
-        if (i > 0) json += ",";
-        json += "{\"slot\":";
-        json += i;
-        json += ",\"species\":";
-        json += ctx->opponentSpecies[i];
-        json += ",\"speciesName\":\"";
-        json += speciesName(g, ctx->opponentSpecies[i]);
-        json += "\",\"level\":";
-        json += ctx->opponentLevels[i];
+    TradeStatus s;
+    tradeStatus_read(ctx, &s);
+    sendCached(request, CACHE_OPPONENT, s.opponentVersion,
+               [&](JsonWriter& w) { writeOpponent(w, s); });
+}
 
-        char nick[NAME_LENGTH + 1];
-        gbTextToAscii((const uint8_t*)ctx->opponentNicknames[i], nick, NAME_LENGTH);
-        json += ",\"nickname\":\"";
-        json += nick;
-        json += "\"}";
+static void handleGetPerf(AsyncWebServerRequest* request) {
+    PerfSummary s;
+    perf_getSummary(&s);
+    uint32_t commits, coalesced, failures;
+    storage_getWriteStats(&commits, &coalesced, &failures);
+
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldUint("sessions", s.sessions);
+    w.fieldUint("trades", s.trades);
+    w.fieldUint("elapsedMs", s.elapsedMs);
+    w.key("tradesPerSec");
+    w.fixed2(s.tradesPerSecX100);
+    w.fieldUint("handlerAvgNs", s.handlerAvgNs);
+    w.fieldUint("handlerMaxNs", s.handlerMaxNs);
+    w.fieldUint("turnaroundMaxUs", s.turnaroundMaxUs);
+    w.fieldUint("overruns", s.overruns);
+    w.fieldUint("heapFirst", s.heapFirst);
+    w.fieldUint("heapLast", s.heapLast);
+    w.fieldUint("heapMin", s.heapMin);
+    w.fieldInt("driftNs", s.driftNs);
+    w.fieldUint("storageCommits", commits);
+    w.fieldUint("storageCoalesced", coalesced);
+    w.fieldUint("storageFailures", failures);
+    w.fieldUint("commands", s.commands);
+    w.fieldUint("commandAvgUs", s.commandAvgUs);
+    w.fieldUint("commandMaxUs", s.commandMaxUs);
+    w.fieldUint("commandsDropped", ctx->commandsDropped);
+    w.fieldUint("responseCacheHits", cacheHits);
+    w.fieldUint("responseCacheMisses", cacheMisses);
+    w.key("json");
+    w.beginObject();
+    w.fieldUint("inPlace", jsonInPlace);
+    w.fieldUint("copied", jsonCopied);
+    w.fieldUint("bytes", jsonBytes);
+    w.fieldInt("peakBodies", jsonPeak);
+    w.endObject();
+    uint32_t logWritten, logDropped;
+    log_getStats(&logWritten, &logDropped);
+    w.fieldUint("logWritten", logWritten);
+    w.fieldUint("logDropped", logDropped);
+    PrinterStats ps;
+    printer_getStats(&ps);
+    w.key("printer");
+    w.beginObject();
+    w.fieldUint("packets", ps.packets);
+    w.fieldUint("checksumErrors", ps.checksumErrors);
+    w.fieldUint("images", ps.images);
+    w.fieldUint("droppedImages", ps.droppedImages);
+    w.fieldUint("overflowBytes", ps.overflowBytes);
+    w.endObject();
+    PngStats png;
+    png_getStats(&png);
+    w.key("png");
+    w.beginObject();
+    w.fieldUint("images", png.images);
+    w.fieldUint("rows", png.rows);
+    w.fieldUint("rawBytes", png.rawBytes);
+    w.fieldUint("pngBytes", png.pngBytes);
+    w.fieldUint("rowAvgUs", png.rows ? png.encodeUs / png.rows : 0);
+    w.fieldUint("rowMaxUs", png.rowMaxUs);
+    w.fieldUint("streamBytes", sizeof(PngStream));
+    w.fieldInt("peakStreams", pngPeak);
+    w.endObject();
+
+    LinkTiming lt;
+    link_getTiming(&lt);
+    w.key("clock");
+    w.beginObject();
+    w.fieldStr("profile", lt.profile);
+    w.fieldUint("bitNs", lt.bitNs);
+    w.fieldUint("gapUs", lt.gapUs);
+    w.fieldUint("peakGapUs", lt.peakGapUs);
+    w.fieldInt("slackUs", lt.slackUs);
+    w.fieldUint("partialTimeoutUs", lt.partialTimeoutUs);
+    w.fieldUint("flushIdleMs", lt.flushIdleMs);
+    w.endObject();
+
+    w.key("master");
+    w.beginArray();
+    for (int r = 0; r < LINK_CLOCK_RATES; r++) {
+        LinkMasterStats m;
+        link_master_getStats((LinkClockRate)r, &m);
+        if (m.hz == 0) continue;            // Not run yet
+        w.beginObject();
+        w.fieldUint("hz", m.hz);
+        w.fieldUint("clockHz", m.clockHz);
+        w.fieldBool("perByte", m.perByte);
+        w.fieldUint("bytes", m.bytes);
+        w.fieldUint("elapsedUs", m.elapsedUs);
+        w.fieldUint("bytesPerSec", m.bytesPerSec);
+        w.fieldUint("bitMinNs", m.bitMinNs);
+        w.fieldUint("bitAvgNs", m.bitAvgNs);
+        w.fieldUint("bitMaxNs", m.bitMaxNs);
+        w.fieldUint("lateBits", m.lateBits);
+        w.fieldUint("dataErrors", m.dataErrors);
+        w.endObject();
+    }
+    w.endArray();
+
+    FramingStats fs;
+    framing_getStats(&fs);
+    w.key("framing");
+    w.beginObject();
+    w.fieldUint("slips", fs.slips);
+    w.fieldUint("realigned", fs.realigned);
+    w.key("slipBits");                      // Index = slip size in bits
+    w.beginArray();
+    for (int b = 0; b < 8; b++) w.unum(fs.slipBits[b]);
+    w.endArray();
+#if LINK_BACKEND == LINK_BACKEND_SIM
+    SimFaultStats sf;
+    sim_getFaultStats(&sf);
+    w.key("faults");
+    w.beginObject();
+    w.fieldUint("every", SIM_FAULT_EVERY);
+    w.fieldUint("dropped", sf.dropped);
+    w.fieldUint("glitches", sf.glitches);
+    w.fieldUint("byRealign", sf.byRealign);
+    w.fieldUint("byIdle", sf.byIdle);
+    w.fieldUint("recoveryAvgBytes", sf.recoveryAvgBytes);
+    w.fieldUint("recoveryMaxBytes", sf.recoveryMaxBytes);
+    w.fieldUint("recoveryAvgUs", sf.recoveryAvgUs);
+    w.fieldUint("recoveryMaxUs", sf.recoveryMaxUs);
+    w.endObject();
+#endif
+    w.endObject();
+
+    PerfStateStats states[PERF_BUCKETS];
+    int n = perf_getStates(states, PERF_BUCKETS);
+
+    w.key("states");
+    w.beginArray();
+    for (int i = 0; i < n; i++) {
+        w.beginObject();
+        w.fieldStr("state", states[i].name);
+        w.fieldUint("count", states[i].count);
+        w.fieldUint("avgNs", states[i].avgNs);
+        w.fieldUint("maxNs", states[i].maxNs);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    sendJson(request, w);
+}
+
+// Runs on the loop between sessions; results appear under "master" in /api/perf
+static void handleMasterBench(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                              size_t index, size_t total) {
+    postCommand(request, CMD_MASTER_BENCH, 0);
+}
+
+static void handlePerfReset(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                             size_t index, size_t total) {
+    postCommand(request, CMD_PERF_RESET, 0);    // The loop owns the counters
+}
+
+// =============================================================================
+// Box Database Handlers
+// =============================================================================
+
+#define BOX_LIST_MAX 50
+
+static void handleGetBox(AsyncWebServerRequest* request) {
+    BoxQuery q;
+    box_queryInit(&q);
+    if (request->hasParam("gen")) {
+        String g = request->getParam("gen")->value();
+        q.gen = (g == "gen1" || g == "1") ? GEN_1 : GEN_2;
+    }
+    q.species = queryInt(request, "species", -1);
+    if (q.species < -1 || q.species > 255) {
+        request->send(400, "application/json", "{\"error\":\"invalid species\"}");
+        return;
+    }
+    q.minLevel = queryInt(request, "minLevel", 0);
+    q.maxLevel = queryInt(request, "maxLevel", 255);
+    q.otId = queryInt(request, "otId", -1);
+    if (request->hasParam("ot")) {
+        q.matchOtName = true;
+        asciiToGbText(request->getParam("ot")->value().c_str(), q.otName, NAME_LENGTH);
+    }
+    int after = queryInt(request, "after", 0);
+    int limit = queryInt(request, "limit", 20);
+    if (limit < 1) limit = 1;
+    if (limit > BOX_LIST_MAX) limit = BOX_LIST_MAX;
+
+    static BoxHit hits[BOX_LIST_MAX];      // AsyncTCP task stack is small
+    int next;
+    int n = box_search(&q, after, hits, limit, &next);
+
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldInt("total", box_count());
+    w.fieldInt("next", next);
+    w.key("entries");
+    w.beginArray();
+    for (int i = 0; i < n; i++) {
+        w.beginObject();
+        w.fieldInt("id", hits[i].id);
+        w.fieldStr("gen", genName(hits[i].gen));
+        w.fieldInt("species", hits[i].species);
+        w.fieldStr("speciesName", speciesName(hits[i].gen, hits[i].species));
+        w.fieldInt("level", hits[i].level);
+        w.fieldInt("otId", hits[i].otId);
+
+        Generation g;
+        StoredPokemon mon;
+        if (box_get(hits[i].id, &g, &mon)) {
+            char text[NAME_LENGTH + 1];
+            gbTextToAscii(mon.nickname, text, NAME_LENGTH);
+            w.fieldStr("nickname", text);
+            gbTextToAscii(mon.ot, text, NAME_LENGTH);
+            w.fieldStr("ot", text);
+        }
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    sendJson(request, w);
+}
+
+// Copy a box entry into a party slot of its generation
+static void handleBoxLoad(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                          size_t index, size_t total) {
+    String body = String((char*)data, len);
+    int id = bodyInt(body, "id", -1);
+    int slot = bodyInt(body, "slot", -1);
+
+    Generation g;
+    StoredPokemon mon;
+    if (slot < 0 || slot >= PARTY_LENGTH || id < 0 || id >= BOX_MAX_RECORDS ||
+        !box_get(id, &g, &mon)) {
+        request->send(400, "application/json", "{\"error\":\"invalid id or slot\"}");
+        return;
+    }
+    storage_saveSlot(g, slot, &mon);
+    request->send(200, "application/json", "{\"ok\":true}");
+}
+
+// Copy a party slot into the box
+static void handleBoxStore(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                           size_t index, size_t total) {
+    String body = String((char*)data, len);
+    Generation g = (body.indexOf("\"gen1\"") >= 0) ? GEN_1 : GEN_2;
+    int slot = bodyInt(body, "slot", -1);
+
+    if (slot < 0 || slot >= PARTY_LENGTH || !storage_getParty(g)[slot].occupied) {
+        request->send(400, "application/json", "{\"error\":\"invalid slot\"}");
+        return;
+    }
+    StoredPokemon mon = storage_getParty(g)[slot];
+    int id = box_add(g, &mon);
+    if (id < 0) {
+        request->send(507, "application/json", "{\"error\":\"box full\"}");
+        return;
+    }
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldBool("ok", true);
+    w.fieldInt("id", id);
+    w.endObject();
+    sendJson(request, w);
+}
+
+static void handleDeleteBox(AsyncWebServerRequest* request) {
+    uint32_t id;
+    if (!pathId(request, BOX_MAX_RECORDS - 1, &id) || !box_remove(id)) {
+        request->send(404, "application/json", "{\"error\":\"no such entry\"}");
+        return;
+    }
+    request->send(200, "application/json", "{\"ok\":true}");
+}
+
+// =============================================================================
+// Trade Journal Handler
+// =============================================================================
+
+#define JOURNAL_LIST_MAX 50
+
+static void writeJournalMon(JsonWriter& w, int gen, uint8_t species, uint8_t level) {
+    w.fieldInt("species", species);
+    w.fieldStr("speciesName", speciesName(gen, species));
+    w.fieldInt("level", level);
+}
+
+// Newest first; pass the returned "next" as ?before= for the following page
+static void handleGetJournal(AsyncWebServerRequest* request) {
+    uint32_t before = request->hasParam("before")
+                      ? (uint32_t)request->getParam("before")->value().toInt()
+                      : journal_endSeq();
+    int limit = queryInt(request, "limit", 20);
+    if (limit < 1) limit = 1;
+    if (limit > JOURNAL_LIST_MAX) limit = JOURNAL_LIST_MAX;
+
+    static JournalRecord recs[JOURNAL_LIST_MAX];
+    int n = journal_read(before, recs, limit);
+
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldInt("next", (n == limit && recs[n - 1].seq > 1) ? (int)recs[n - 1].seq : -1);
+    w.key("entries");
+    w.beginArray();
+    for (int i = 0; i < n; i++) {
+        const JournalRecord* r = &recs[i];
+        char ot[NAME_LENGTH + 1];
+        gbTextToAscii(r->recvOt, ot, NAME_LENGTH);
+
+        w.beginObject();
+        w.fieldUint("seq", r->seq);
+        w.fieldUint("boot", r->boot);
+        w.fieldUint("uptimeS", r->uptimeS);
+        w.fieldUint("sessionMs", r->sessionMs);
+        w.fieldStr("gen", genName(r->gen));
+        w.fieldStr("mode", r->mode == TRADE_MODE_CLONE ? "clone" : "storage");
+        w.key("sent");
+        w.beginObject();
+        writeJournalMon(w, r->gen, r->sentSpecies, r->sentLevel);
+        w.endObject();
+        w.key("received");
+        w.beginObject();
+        writeJournalMon(w, r->gen, r->recvSpecies, r->recvLevel);
+        w.fieldStr("ot", ot);
+        w.fieldUint("otId", r->recvOtId);
+        w.endObject();
+        w.fieldInt("slot", r->savedSlot == 0xFF ? -1 : (int)r->savedSlot);
+        w.fieldInt("boxId", (int)r->boxId);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    sendJson(request, w);
+}
+
+// =============================================================================
+// Session Capture Handlers
+// =============================================================================
+
+// {"enabled":true} records every following session until turned off
+static void handleSetCapture(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                             size_t index, size_t total) {
+    String body = String((char*)data, len);
+    postCommand(request, CMD_SET_CAPTURE, body.indexOf("true") >= 0);
+}
+
+static void handleGetCaptures(AsyncWebServerRequest* request) {
+    CaptureInfo list[CAPTURE_MAX_FILES];
+    int n = capture_list(list, CAPTURE_MAX_FILES);
+
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldBool("enabled", capture_isEnabled());
+    w.key("captures");
+    w.beginArray();
+    for (int i = n - 1; i >= 0; i--) {
+        w.beginObject();
+        w.fieldUint("id", list[i].id);
+        w.fieldUint("size", list[i].size);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    sendJson(request, w);
+}
+
+// Capture id from the path, or answer 404 / 409 (still being written) and
+// return false
+static bool captureId(AsyncWebServerRequest* request, uint16_t* id) {
+    uint32_t v;
+    if (!pathId(request, 0xFFFF, &v)) {
+        request->send(404, "application/json", "{\"error\":\"no such capture\"}");
+        return false;
+    }
+    if (capture_isWriting(v)) {
+        request->send(409, "application/json", "{\"error\":\"capture still recording\"}");
+        return false;
+    }
+    *id = v;
+    return true;
+}
+
+static void handleDownloadCapture(AsyncWebServerRequest* request) {
+    uint16_t id;
+    if (!captureId(request, &id)) return;
+    char path[32];
+    capture_path(id, path, sizeof(path));
+    if (!LittleFS.exists(path)) {
+        request->send(404, "application/json", "{\"error\":\"no such capture\"}");
+        return;
+    }
+    request->send(LittleFS, path, "application/octet-stream", true);
+}
+
+static void handleDeleteCapture(AsyncWebServerRequest* request) {
+    uint16_t id;
+    if (!captureId(request, &id)) return;
+    if (!capture_remove(id)) {
+        request->send(404, "application/json", "{\"error\":\"no such capture\"}");
+        return;
+    }
+    request->send(200, "application/json", "{\"ok\":true}");
+}
+
+// =============================================================================
+// Printed Images
+// PNGs are encoded while they are sent: each chunk the response asks for pulls
+// the next tile row out of the printer FIFO or a gallery file. Encoder state
+// comes from a fixed pool, handed back when the request goes away (finished
+// or aborted).
+// =============================================================================
+
+static bool readPrinterRow(void* ctx, int row, uint8_t* tiles) {
+    return printer_readRow((uint32_t)(uintptr_t)ctx, row, tiles);
+}
+
+static bool readGalleryRow(void* ctx, int row, uint8_t* tiles) {
+    return gallery_readRow((File*)ctx, row, tiles);
+}
+
+static bool sendNotModified(AsyncWebServerRequest* request, const char* etag) {
+    if (!request->hasHeader("If-None-Match") ||
+        !(request->getHeader("If-None-Match")->value() == etag)) {
+        return false;
+    }
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    request->send(response);
+    return true;
+}
+
+// Take an encoder slot for this request, or answer 503 and return -1
+static int claimPngSlot(AsyncWebServerRequest* request) {
+    int slot = 0;
+    while (slot < PNG_STREAMS && pngBusy[slot]) slot++;
+    if (slot == PNG_STREAMS) {
+        request->send(503, "application/json", "{\"error\":\"encoder busy\"}");
+        return -1;
+    }
+    pngBusy[slot] = true;
+    if (++pngActive > pngPeak) pngPeak = pngActive;
+    request->onDisconnect([slot]() {
+        if (pngFiles[slot]) pngFiles[slot].close();
+        pngBusy[slot] = false;
+        pngActive--;
+    });
+    return slot;
+}
+
+// ?deflate=stored skips compression (faster, about 4x larger)
+static void sendPng(AsyncWebServerRequest* request, int slot, uint16_t rows, uint8_t palette,
+                    PngRowReader read, void* readCtx, const char* etag, const char* cacheControl) {
+    bool stored = request->hasParam("deflate") && request->getParam("deflate")->value() == "stored";
+    png_begin(&pngStreams[slot], GBP_TILES_PER_ROW, rows, palette, stored ? PNG_STORED : PNG_FIXED,
+              read, readCtx);
+
+    AsyncWebServerResponse* response = request->beginChunkedResponse("image/png",
+        [slot](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+            return png_read(&pngStreams[slot], buf, maxLen);
+        });
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+}
+
+static void handleGetPrinter(AsyncWebServerRequest* request) {
+    PrinterImageInfo list[MAX_PRINTER_IMAGES];
+    int n = printer_listImages(list, MAX_PRINTER_IMAGES);
+
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.key("images");
+    w.beginArray();
+    for (int i = n - 1; i >= 0; i--) {
+        w.beginObject();
+        w.fieldUint("id", list[i].id);
+        w.fieldInt("width", PNG_WIDTH);
+        w.fieldInt("height", list[i].rows * 8);
+        w.fieldInt("marginBefore", list[i].margins >> 4);
+        w.fieldInt("marginAfter", list[i].margins & 0x0F);
+        w.fieldInt("palette", list[i].palette);
+        w.fieldUint("ageMs", millis() - list[i].printedMs);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    sendJson(request, w);
+}
+
+static void handleGetPrinterPng(AsyncWebServerRequest* request) {
+    uint32_t id = request->pathArg(0).toInt();
+    PrinterImageInfo list[MAX_PRINTER_IMAGES];
+    int n = printer_listImages(list, MAX_PRINTER_IMAGES);
+    const PrinterImageInfo* info = nullptr;
+    for (int i = 0; i < n; i++) {
+        if (list[i].id == id) info = &list[i];
+    }
+    if (!info) {
+        request->send(404, "application/json", "{\"error\":\"no such image\"}");
+        return;
+    }
+
+    // Ids restart at boot; the boot tag keeps a phone from showing an old print
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08x-p%u\"", (unsigned)bootTag, (unsigned)id);
+    if (sendNotModified(request, etag)) return;
+
+    int slot = claimPngSlot(request);
+    if (slot < 0) return;
+    sendPng(request, slot, info->rows, info->palette, readPrinterRow, (void*)(uintptr_t)id,
+            etag, "no-cache");
+}
+
+// =============================================================================
+// Gallery Handlers
+// Image URLs carry the gallery's volume tag (?v=), which changes whenever ids
+// could restart, so prints and thumbnails can be cached for good.
+// =============================================================================
+
+#define GALLERY_PAGE_MAX 24
+#define GALLERY_CACHE_CONTROL "public, max-age=31536000, immutable"
+
+// Newest first: ?offset=0&limit=12
+static void handleGetGallery(AsyncWebServerRequest* request) {
+    int offset = queryInt(request, "offset", 0);
+    int limit = queryInt(request, "limit", 12);
+    if (offset < 0) offset = 0;
+    if (limit < 1) limit = 1;
+    if (limit > GALLERY_PAGE_MAX) limit = GALLERY_PAGE_MAX;
+
+    GalleryEntry page[GALLERY_PAGE_MAX];
+    int total;
+    uint32_t used;
+    int n = gallery_list(offset, page, limit, &total, &used);
+
+    JsonWriter w;
+    jsonBegin(w);
+    w.beginObject();
+    w.fieldInt("total", total);
+    w.fieldInt("next", offset + n < total ? offset + n : -1);
+    w.fieldUint("usedBytes", used);
+    w.fieldUint("budgetBytes", GALLERY_MAX_BYTES);
+    w.fieldUint("volume", gallery_volumeTag());
+    w.key("images");
+    w.beginArray();
+    for (int i = 0; i < n; i++) {
+        const GalleryEntry* e = &page[i];
+        w.beginObject();
+        w.fieldUint("id", e->id);
+        w.fieldInt("width", PNG_WIDTH);
+        w.fieldInt("height", e->rows * 8);
+        w.fieldInt("marginBefore", e->margins >> 4);
+        w.fieldInt("marginAfter", e->margins & 0x0F);
+        w.fieldInt("palette", e->palette);
+        w.fieldUint("boot", e->boot);
+        w.fieldUint("uptimeS", e->uptimeS);
+        w.fieldUint("bytes", e->bytes);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    sendJson(request, w);
+}
+
+// Id from the path and ?v= (if given) from this gallery volume, else 404.
+// ETags carry the tag too, for clients that revalidate an untagged URL.
+static bool galleryId(AsyncWebServerRequest* request, uint32_t* id, char* etag, size_t len,
+                      char kind) {
+    if (!pathId(request, 0xFFFFFFFF, id) ||
+        (request->hasParam("v") &&
+         strtoul(request->getParam("v")->value().c_str(), nullptr, 10) != gallery_volumeTag())) {
+        request->send(404, "application/json", "{\"error\":\"no such print\"}");
+        return false;
+    }
+    snprintf(etag, len, "\"%08x-%c%u\"", (unsigned)gallery_volumeTag(), kind, (unsigned)*id);
+    return true;
+}
+
+static void handleGetGalleryPng(AsyncWebServerRequest* request) {
+    uint32_t id;
+    char etag[24];
+    if (!galleryId(request, &id, etag, sizeof(etag), 'g')) return;
+    GalleryEntry e;
+    if (!gallery_get(id, &e)) {
+        request->send(404, "application/json", "{\"error\":\"no such print\"}");
+        return;
+    }
+
+    if (sendNotModified(request, etag)) return;
+
+    int slot = claimPngSlot(request);
+    if (slot < 0) return;
+    if (!gallery_open(id, &pngFiles[slot])) {
+        request->send(404, "application/json", "{\"error\":\"no such print\"}");
+        return;
+    }
+    sendPng(request, slot, e.rows, e.palette, readGalleryRow, &pngFiles[slot],
+            etag, GALLERY_CACHE_CONTROL);
+}
+
+// Thumbnails were encoded when the print was saved; send the file as is
+static void handleGetGalleryThumb(AsyncWebServerRequest* request) {
+    uint32_t id;
+    char etag[24];
+    if (!galleryId(request, &id, etag, sizeof(etag), 't')) return;
+    char path[32];
+    gallery_thumbPath(id, path, sizeof(path));
+    if (!LittleFS.exists(path)) {
+        request->send(404, "application/json", "{\"error\":\"no such print\"}");
+        return;
+    }
+    if (sendNotModified(request, etag)) return;
+
+    AsyncWebServerResponse* response = request->beginResponse(LittleFS, path, "image/png");
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", GALLERY_CACHE_CONTROL);
+    request->send(response);
+}
+
+static void handleDeleteGallery(AsyncWebServerRequest* request) {
+    uint32_t id;
+    if (!pathId(request, 0xFFFFFFFF, &id) || !gallery_remove(id)) {
+        request->send(404, "application/json", "{\"error\":\"no such print\"}");
+        return;
+    }
+    request->send(200, "application/json", "{\"ok\":true}");
+}
+
+// =============================================================================
+// Live State Stream
+// One SSE event per section: "status", "opponent", "party". A new client gets
+// all of them once, after that only the sections that changed are re-sent.
+// =============================================================================
+
+static uint32_t pushedStatusVersion = 0;
+static uint32_t pushedStorageVersion = 0;
+static uint32_t pushedOpponentVersion = 0;
+static uint32_t lastPushMs = 0;
+
+static void writePartyEvent(JsonWriter& w, Generation g, uint32_t version) {
+    w.beginObject();
+    w.fieldStr("gen", genName(g));
+    w.fieldUint("version", version);
+    w.key("slots");
+    writeParty(w, g);
+    w.endObject();
+}
+
+// Build one section into buf and send it to one client (or all if null)
+template <typename Fn>
+static void sendSection(AsyncEventSourceClient* client, char* buf, size_t len,
+                        const char* event, Fn write) {
+    JsonWriter w;
+    w.begin(buf, len);
+    write(w);
+    if (!w.ok()) return;
+    if (client) client->send(w.c_str(), event, millis());
+    else stateEvents.send(w.c_str(), event, millis());
+}
+
+// Runs in the AsyncTCP task: build the snapshot from the published state
+static void sendSnapshot(AsyncEventSourceClient* client) {
+    TradeStatus s;
+    uint32_t version = tradeStatus_read(ctx, &s);
+    uint32_t storageVersion = storage_getVersion();
+
+    sendSection(client, responseBuf, sizeof(responseBuf), "status",
+                [&](JsonWriter& w) { writeStatus(w, s, version); });
+    sendSection(client, responseBuf, sizeof(responseBuf), "opponent",
+                [&](JsonWriter& w) { writeOpponent(w, s); });
+    sendSection(client, responseBuf, sizeof(responseBuf), "party",
+                [&](JsonWriter& w) { writePartyEvent(w, GEN_1, storageVersion); });
+    sendSection(client, responseBuf, sizeof(responseBuf), "party",
+                [&](JsonWriter& w) { writePartyEvent(w, GEN_2, storageVersion); });
+}
+
+void wifi_pushState() {
+    if (stateEvents.count() == 0) return;
+    uint32_t now = millis();
+    if (now - lastPushMs < STATE_PUSH_MS) return;
+
+    uint32_t version = tradeStatus_version(ctx);
+    uint32_t storageVersion = storage_getVersion();
+    if (version == pushedStatusVersion && storageVersion == pushedStorageVersion) return;
+    lastPushMs = now;
+
+    if (version != pushedStatusVersion) {
+        TradeStatus s;
+        tradeStatus_read(ctx, &s);
+        sendSection(nullptr, pushBuf, sizeof(pushBuf), "status",
+                    [&](JsonWriter& w) { writeStatus(w, s, version); });
+        if (s.opponentVersion != pushedOpponentVersion) {
+            sendSection(nullptr, pushBuf, sizeof(pushBuf), "opponent",
+                        [&](JsonWriter& w) { writeOpponent(w, s); });
+            pushedOpponentVersion = s.opponentVersion;
+        }
+        pushedStatusVersion = version;
+    }
+
+    if (storageVersion != pushedStorageVersion) {
+        sendSection(nullptr, pushBuf, sizeof(pushBuf), "party",
+                    [&](JsonWriter& w) { writePartyEvent(w, GEN_1, storageVersion); });
+        sendSection(nullptr, pushBuf, sizeof(pushBuf), "party",
+                    [&](JsonWriter& w) { writePartyEvent(w, GEN_2, storageVersion); });
+        pushedStorageVersion = storageVersion;
     }
-    json += "]";
-    request->send(200, "application/json", json);
 }
 
 // =============================================================================
@@ -265,6 +1357,7 @@ static void handleGetOpponent(AsyncWebServerRequest* request) {
 
 void wifi_init(TradeContext* tradeCtx) {
     ctx = tradeCtx;
+    bootTag = esp_random();
 
     // Start LittleFS
     if (!LittleFS.begin(true)) {
@@ -285,18 +1378,45 @@ void wifi_init(TradeContext* tradeCtx) {
     });
     server.addHandler(&events);
 
+    // Binary SPI trace for debug page
+    traceWs.onEvent(onTraceEvent);
+    server.addHandler(&traceWs);
+
+    // Live state for the dashboard: full snapshot on connect, then deltas
+    stateEvents.onConnect(sendSnapshot);
+    server.addHandler(&stateEvents);
+
     // REST API routes (must be registered before serveStatic catch-all)
     server.on("/api/status", HTTP_GET, handleStatus);
     server.on("/api/opponent", HTTP_GET, handleGetOpponent);
+    server.on("/api/perf", HTTP_GET, handleGetPerf);
 
     server.on("^\\/api\\/pokemon\\/([a-z0-9]+)$", HTTP_GET, handleGetPokemon);
     server.on("^\\/api\\/pokemon\\/([a-z0-9]+)\\/([0-9]+)$", HTTP_DELETE, handleDeletePokemon);
+    server.on("/api/box", HTTP_GET, handleGetBox);
+    server.on("/api/journal", HTTP_GET, handleGetJournal);
+    server.on("^\\/api\\/box\\/([0-9]+)$", HTTP_DELETE, handleDeleteBox);
+    server.on("/api/printer", HTTP_GET, handleGetPrinter);
+    server.on("^\\/api\\/printer\\/([0-9]+)\\.png$", HTTP_GET, handleGetPrinterPng);
+    server.on("/api/gallery", HTTP_GET, handleGetGallery);
+    server.on("^\\/api\\/gallery\\/([0-9]+)\\.png$", HTTP_GET, handleGetGalleryPng);
+    server.on("^\\/api\\/gallery\\/([0-9]+)\\/thumb\\.png$", HTTP_GET, handleGetGalleryThumb);
+    server.on("^\\/api\\/gallery\\/([0-9]+)$", HTTP_DELETE, handleDeleteGallery);
+    server.on("/api/captures", HTTP_GET, handleGetCaptures);
+    server.on("^\\/api\\/capture\\/([0-9]+)$", HTTP_GET, handleDownloadCapture);
+    server.on("^\\/api\\/capture\\/([0-9]+)$", HTTP_DELETE, handleDeleteCapture);
 
     server.on("/api/mode", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleSetMode);
     server.on("/api/trade/offer", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleTradeOffer);
     server.on("/api/trade/confirm", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleTradeConfirm);
     server.on("/api/trade/decline", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleTradeDecline);
+    server.on("/api/trade/hold", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleTradeHold);
     server.on("/api/trade/auto", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleTradeAuto);
+    server.on("/api/box/load", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleBoxLoad);
+    server.on("/api/box/store", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleBoxStore);
+    server.on("/api/capture", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleSetCapture);
+    server.on("/api/perf/reset", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handlePerfReset);
+    server.on("/api/link/master/bench", HTTP_POST, [](AsyncWebServerRequest* r){}, nullptr, handleMasterBench);
 
     // Static files last (catch-all)
     server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");